@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace {
+
+/// Milliseconds taken by the fastest of `runs` generations of the options.
+double bestMs(const RunningOpt &opt, int runs, std::size_t &found) {
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    auto started = std::chrono::steady_clock::now();
+    bpg::PuzzleStore store = bpg::Generator::generate(opt);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    best = run == 0 ? ms : std::min(best, ms);
+    found = store.size();
+  }
+  return best;
+}
+
+}
+
+/// Times constrained generation on 10x10: five ship cells, water rows 2 and 6 and water
+/// column 0, against the same board without constraints.
+/// Usage: bench_constraints [puzzles (100)] [runs per measurement (3)]
+int main(int argc, char *argv[]) {
+  unsigned int n = static_cast<unsigned int>(argc > 1 ? std::atoi(argv[1]) : 100);
+  int runs = argc > 2 ? std::atoi(argv[2]) : 3;
+  RunningOpt opt;
+  opt.rows = opt.cols = 10;
+  opt.n_puzzles = n;
+  std::size_t plainFound = 0, constrainedFound = 0;
+  double plain = bestMs(opt, runs, plainFound);
+
+  const int ships[][2] = { { 0, 2 }, { 3, 5 }, { 4, 8 }, { 8, 3 }, { 9, 9 } };
+  for (const auto &cell : ships) {
+    opt.required[cell[0]] |= std::uint16_t(1u << cell[1]);
+  }
+  opt.forbidden[2] = opt.forbidden[6] = 0x3FF;
+  for (int r = 0; r < opt.rows; r++) {
+    opt.forbidden[r] |= 1u;
+  }
+  double constrained = bestMs(opt, runs, constrainedFound);
+
+  std::printf("  constraints  puzzles    time(ms)\n");
+  std::printf("%13s %8zu %11.2f\n", "none", plainFound, plain);
+  std::printf("%13s %8zu %11.2f\n", "partial board", constrainedFound, constrained);
+  return 0;
+}
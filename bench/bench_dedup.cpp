@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "common.h"
+#include "dedup.h"
+#include "store.h"
+#include "zdd.h"
+
+namespace {
+
+/// Checks per second of a duplicate check with the budget, over every record twice
+/// (the second pass finds only duplicates).
+double checksPerSecond(const std::vector<bpg::PuzzleRecord> &first, const std::vector<bpg::PuzzleRecord> &second,
+                       std::size_t budgetKb, std::size_t &spills) {
+  auto started = std::chrono::steady_clock::now();
+  bpg::Deduplicator keys(budgetKb * 1024);
+  std::size_t fresh = 0;
+  for (const bpg::PuzzleRecord &rec : first) {
+    fresh += keys.insert(rec);
+  }
+  for (const bpg::PuzzleRecord &rec : second) {
+    fresh += keys.insert(rec);
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  if (fresh != first.size()) {
+    std::fprintf(stderr, "wrong answer: %zu new of %zu\n", fresh, first.size());
+    std::exit(1);
+  }
+  spills = keys.spills();
+  return (first.size() + second.size()) / s;
+}
+
+}
+
+/// Times the duplicate check on distinct 8x8 layouts (taken from the layout ZDD, in random
+/// order), unbounded and within memory budgets.
+/// Usage: bench_dedup [distinct puzzles (2000000)] [budgets in KB (0 = none) ... (0 16384 1024)]
+int main(int argc, char *argv[]) {
+  std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+  std::vector<std::size_t> budgets;
+  for (int i = 2; i < argc; i++) {
+    budgets.push_back(std::strtoul(argv[i], nullptr, 10));
+  }
+  if (budgets.empty()) {
+    budgets = { 0, 16384, 1024 };
+  }
+
+  bpg::LayoutZdd zdd;
+  if (not zdd.build(8, 8)) {
+    std::fprintf(stderr, "could not build the 8x8 layout ZDD\n");
+    return 1;
+  }
+  n = static_cast<std::size_t>(std::min<bpg::zdd_count>(n, zdd.count()));
+  std::mt19937_64 rng(7);
+  std::vector<bpg::PuzzleRecord> first(n);
+  for (std::size_t k = 0; k < n; k++) {
+    first[k] = zdd.unrank(bpg::zdd_count(k) * (zdd.count() / n)).canonical();
+  }
+  std::shuffle(first.begin(), first.end(), rng);
+  std::vector<bpg::PuzzleRecord> second = first;
+  std::shuffle(second.begin(), second.end(), rng);
+
+  std::printf(" budget(KB)    checks   M checks/s  spills\n");
+  for (std::size_t kb : budgets) {
+    std::size_t spills = 0;
+    double rate = checksPerSecond(first, second, kb, spills);
+    std::printf("%11zu %9zu %12.2f %7zu\n", kb, 2 * n, rate / 1e6, spills);
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace {
+
+/// Milliseconds taken by the fastest of `runs` generations of the options.
+double bestMs(const RunningOpt &opt, int runs, std::size_t &found) {
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    auto started = std::chrono::steady_clock::now();
+    bpg::PuzzleStore store = bpg::Generator::generate(opt);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    best = run == 0 ? ms : std::min(best, ms);
+    found = store.size();
+  }
+  return best;
+}
+
+}
+
+/// Times the head-cell scan and the Dancing Links engine on every board from 7x7 to 16x16.
+/// Usage: bench_engines [puzzles per board (100)] [runs per measurement (3)]
+int main(int argc, char *argv[]) {
+  unsigned short n = static_cast<unsigned short>(argc > 1 ? std::atoi(argv[1]) : 100);
+  int runs = argc > 2 ? std::atoi(argv[2]) : 3;
+  std::printf(" dims  puzzles    dfs(ms)    dlx(ms)  dfs/dlx\n");
+  for (unsigned short r = min_rows; r <= max_rows; r++) {
+    for (unsigned short c = min_cols; c <= max_cols; c++) {
+      RunningOpt opt;
+      opt.rows = r;
+      opt.cols = c;
+      opt.n_puzzles = n;
+      std::size_t dfsFound = 0, dlxFound = 0;
+      opt.engine = engine_t::dfs;
+      double dfs = bestMs(opt, runs, dfsFound);
+      opt.engine = engine_t::dlx;
+      double dlx = bestMs(opt, runs, dlxFound);
+      std::printf("%2ux%-2u %8zu %10.2f %10.2f %8.2f\n", r, c, std::min(dfsFound, dlxFound), dfs, dlx, dfs / dlx);
+    }
+  }
+  return 0;
+}
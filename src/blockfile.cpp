@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include "include/blockfile.h"
+#include "include/bpg.h"
+#include "include/common.h"
+
+namespace bpg{
+
+  namespace {
+    constexpr char block_magic[8] = { 'B', 'P', 'G', 'B', 'L', 'K', '\0', '\0' };
+    constexpr std::uint32_t block_version{ 1 };
+
+    /// Header at the beginning of a block file (48 bytes).
+    struct BlockHeader {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t blockPuzzles;   //!< Puzzles per block (the last one may hold fewer).
+      std::uint64_t puzzleCount;
+      std::uint64_t blockCount;
+      std::uint64_t indexOffset;    //!< File offset of the block index.
+      std::uint32_t preambleSize;   //!< Bytes of uncompressed preamble right after the header.
+      std::uint32_t reserved;
+    };
+
+    /// Entry of the block index.
+    struct BlockEntry {
+      std::uint64_t offset;          //!< File offset of the compressed block.
+      std::uint32_t compressedSize;
+      std::uint32_t rawSize;         //!< Puzzle offsets plus text.
+    };
+
+    /// zlib never inflates data by more than about 1032 to 1.
+    constexpr std::uint64_t max_inflate_ratio{ 1032 };
+
+    /**
+     * Reads the header and checks that it matches the file: the block count fits the
+     * puzzle count, and the block index lies after the preamble and within the file.
+     */
+    bool readHeader(std::ifstream &in, BlockHeader &header) {
+      in.read(reinterpret_cast<char*>(&header), sizeof(header));
+      if (not in or std::memcmp(header.magic, block_magic, sizeof(block_magic)) != 0
+          or header.version != block_version or header.blockPuzzles == 0) {
+        return false;
+      }
+      in.seekg(0, std::ios::end);
+      std::uint64_t fileSize = std::uint64_t(in.tellg());
+      std::uint64_t blocks = header.puzzleCount / header.blockPuzzles + (header.puzzleCount % header.blockPuzzles != 0);
+      return in and header.blockCount == blocks and header.indexOffset >= sizeof(header) + header.preambleSize
+             and header.indexOffset <= fileSize
+             and header.blockCount <= (fileSize - header.indexOffset) / sizeof(BlockEntry);
+    }
+
+    /**
+     * Reads and decompresses block `b`.
+     * The raw block starts with n+1 offsets (n puzzles) relative to the text that follows;
+     * the entry, the sizes and the offsets are checked, so a damaged file fails here.
+     */
+    bool readBlock(std::ifstream &in, const BlockHeader &header, std::size_t b, std::string &raw) {
+      BlockEntry entry;
+      if (b >= header.blockCount) {
+        return false;
+      }
+      in.seekg(std::streamoff(header.indexOffset + b * sizeof(BlockEntry)));
+      in.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+      std::uint64_t n = std::min<std::uint64_t>(header.blockPuzzles, header.puzzleCount - b * header.blockPuzzles);
+      std::uint64_t offsetBytes = (n + 1) * sizeof(std::uint32_t);
+      if (not in or entry.offset < sizeof(header) + header.preambleSize or entry.offset > header.indexOffset
+          or entry.compressedSize > header.indexOffset - entry.offset or entry.rawSize < offsetBytes
+          or entry.rawSize > std::uint64_t(entry.compressedSize) * max_inflate_ratio + 64) {
+        return false;
+      }
+      std::string packed(entry.compressedSize, '\0');
+      in.seekg(std::streamoff(entry.offset));
+      in.read(packed.data(), std::streamsize(packed.size()));
+      if (not in) {
+        return false;
+      }
+      raw.assign(entry.rawSize, '\0');
+      uLongf size = entry.rawSize;
+      if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &size,
+                     reinterpret_cast<const Bytef*>(packed.data()), uLong(packed.size())) != Z_OK
+          or size != entry.rawSize) {
+        return false;
+      }
+      std::vector<std::uint32_t> offsets(n + 1);
+      std::memcpy(offsets.data(), raw.data(), offsetBytes);
+      return offsets[0] == 0 and std::is_sorted(offsets.begin(), offsets.end())
+             and offsets[n] == entry.rawSize - offsetBytes;
+    }
+  }
+
+/**
+ * @brief Gives the name of the block file matching a plain output file.
+ *
+ * @param FileName The name of the plain file, such as `puzzles_armada.bp`.
+ * @return The same name ending in `.bpz`.
+ */
+  std::string BlockFileName(const std::string &FileName) {
+    const std::string plain = ".bp";
+    if (FileName.size() >= plain.size() and FileName.compare(FileName.size() - plain.size(), plain.size(), plain) == 0) {
+      return FileName + "z";
+    }
+    return FileName + ".bpz";
+  }
+
+/**
+ * @brief Checks whether a file is a block file.
+ *
+ * @param FileName The name of the file.
+ * @return True if the file starts with a valid block file header.
+ */
+  bool IsBlockFile(const std::string &FileName) {
+    std::ifstream in(FileName, std::ios::binary);
+    BlockHeader header;
+    return readHeader(in, header);
+  }
+
+/**
+ * @brief Writes the text of many puzzles as a block file, replacing the file.
+ *
+ * Worker threads render and compress whole blocks, each with its own scratch puzzle;
+ * the calling thread writes the blocks in order as they become ready.
+ *
+ * @param FileName The name of the block file.
+ * @param preamble The text before the first puzzle, kept uncompressed.
+ * @param count The number of puzzles.
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @param text Renders the text of one puzzle.
+ * @return The sizes and time of the write; zero compressed bytes if the file could not be written.
+ */
+  CompressionReport SaveBlocks(const std::string &FileName, const std::string &preamble, std::size_t count,
+                               short rows, short cols, const PuzzleText &text) {
+    auto started = std::chrono::steady_clock::now();
+    CompressionReport report;
+    std::ofstream out(FileName, std::ios::binary | std::ios::trunc);
+    if (not out.is_open()) {
+      std::cerr << "Error trying to open file: " << FileName << std::endl;
+      return report;
+    }
+
+    std::size_t blocks = (count + block_puzzles - 1) / block_puzzles;
+    std::vector<std::string> packed(blocks);
+    std::vector<BlockEntry> index(blocks);
+    std::vector<bool> ready(blocks, false);
+    std::mutex lock;
+    std::condition_variable done;
+    std::atomic<std::size_t> next{ 0 };
+
+    auto worker = [&]() {
+      Puzzle pz(cols, rows);
+      std::string body, raw, puzzle;
+      for (std::size_t b = next++; b < blocks; b = next++) {
+        std::size_t first = b * block_puzzles;
+        std::size_t n = std::min<std::size_t>(block_puzzles, count - first);
+        std::vector<std::uint32_t> offsets(n + 1, 0);
+        body.clear();
+        for (std::size_t i = 0; i < n; i++) {
+          offsets[i] = std::uint32_t(body.size());
+          text(first + i, pz, puzzle);
+          body += puzzle;
+        }
+        offsets[n] = std::uint32_t(body.size());
+        raw.assign(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(std::uint32_t));
+        raw += body;
+
+        uLongf size = compressBound(uLong(raw.size()));
+        std::string z(size, '\0');
+        compress2(reinterpret_cast<Bytef*>(z.data()), &size, reinterpret_cast<const Bytef*>(raw.data()),
+                  uLong(raw.size()), Z_DEFAULT_COMPRESSION);
+        z.resize(size);
+
+        std::lock_guard<std::mutex> guard(lock);
+        packed[b].swap(z);
+        index[b].compressedSize = std::uint32_t(size);
+        index[b].rawSize = std::uint32_t(raw.size());
+        report.rawBytes += body.size();
+        ready[b] = true;
+        done.notify_one();
+      }
+    };
+    std::size_t threads = std::min<std::size_t>(blocks, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> pool;
+    for (std::size_t t = 0; t < threads; t++) {
+      pool.emplace_back(worker);
+    }
+
+    BlockHeader header{};
+    std::memcpy(header.magic, block_magic, sizeof(block_magic));
+    header.version = block_version;
+    header.blockPuzzles = block_puzzles;
+    header.puzzleCount = count;
+    header.blockCount = blocks;
+    header.preambleSize = std::uint32_t(preamble.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out << preamble;
+
+    std::uint64_t offset = sizeof(header) + preamble.size();
+    for (std::size_t b = 0; b < blocks; b++) {
+      std::string z;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&] { return ready[b]; });
+        z.swap(packed[b]);
+        index[b].offset = offset;
+      }
+      out.write(z.data(), std::streamsize(z.size()));
+      offset += z.size();
+    }
+    for (std::thread &t : pool) {
+      t.join();
+    }
+
+    header.indexOffset = offset;
+    out.write(reinterpret_cast<const char*>(index.data()), std::streamsize(index.size() * sizeof(BlockEntry)));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (not out) {
+      std::cerr << "Error trying to write file: " << FileName << std::endl;
+      return report;
+    }
+
+    report.rawBytes += preamble.size();
+    report.compressedBytes = offset + index.size() * sizeof(BlockEntry);
+    report.blocks = blocks;
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return report;
+  }
+
+/**
+ * @brief Reads the whole text of a block file.
+ *
+ * @param FileName The name of the block file.
+ * @param text Receives the text, the same as the matching plain file.
+ * @return True on success, false if the file is missing or damaged.
+ */
+  bool ReadBlockFile(const std::string &FileName, std::string &text) {
+    std::ifstream in(FileName, std::ios::binary);
+    BlockHeader header;
+    if (not readHeader(in, header)) {
+      return false;
+    }
+    text.assign(header.preambleSize, '\0');
+    in.seekg(std::streamoff(sizeof(header)));
+    in.read(text.data(), header.preambleSize);
+    if (not in) {
+      return false;
+    }
+    std::string raw;
+    for (std::size_t b = 0; b < header.blockCount; b++) {
+      if (not readBlock(in, header, b, raw)) {
+        return false;
+      }
+      std::size_t n = std::min<std::size_t>(header.blockPuzzles, header.puzzleCount - b * header.blockPuzzles);
+      text.append(raw, (n + 1) * sizeof(std::uint32_t), std::string::npos);
+    }
+    return true;
+  }
+
+/**
+ * @brief Reads the text of a single puzzle, decompressing only its block.
+ *
+ * @param FileName The name of the block file.
+ * @param k The number of the puzzle, starting at zero.
+ * @param text Receives the text of the puzzle.
+ * @return True on success, false if there is no such puzzle or the file is damaged.
+ */
+  bool ReadBlockPuzzle(const std::string &FileName, std::size_t k, std::string &text) {
+    std::ifstream in(FileName, std::ios::binary);
+    BlockHeader header;
+    std::string raw;
+    if (not readHeader(in, header) or k >= header.puzzleCount
+        or not readBlock(in, header, k / header.blockPuzzles, raw)) {
+      return false;
+    }
+    std::size_t i = k % header.blockPuzzles;
+    std::uint32_t bounds[2];
+    std::memcpy(bounds, raw.data() + i * sizeof(std::uint32_t), sizeof(bounds));
+    std::size_t n = std::min<std::size_t>(header.blockPuzzles, header.puzzleCount - (k - i));
+    text = raw.substr((n + 1) * sizeof(std::uint32_t) + bounds[0], bounds[1] - bounds[0]);
+    return true;
+  }
+
+}
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/dedup.h"
+#include "include/store.h"
+
+namespace bpg{
+
+  namespace {
+    constexpr std::uint16_t free_slot{ 0xFFFF };   // `vertical` never uses more than 10 bits.
+    constexpr std::size_t bloom_block_words{ 8 };  // 512-bit blocks, one cache line.
+    constexpr int bloom_probes{ 8 };
+    constexpr std::size_t max_runs{ 8 };
+    constexpr std::size_t fence_stride{ 256 };     // Records of a run per in-memory fence key, at least.
+    constexpr std::size_t bloom_bits{ 10 };        // Filter bits per record, about 1% false positives.
+    constexpr std::size_t merge_buffer{ 4096 };    // Records written at once by a merge, at most.
+    constexpr double max_load{ 0.7 };
+
+    std::uint64_t mix(std::uint64_t x) {
+      x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+      x ^= x >> 27; x *= 0x94D049BB133111EBull;
+      return x ^ (x >> 31);
+    }
+  }
+
+/**
+ * @brief Creates an empty set.
+ *
+ * The Bloom filter gets up to a quarter of the budget, sized for the records expected
+ * by the first merge, and the exact table the largest power of two slots that fits
+ * in the rest, next to the merge buffer.
+ *
+ * @param budgetBytes The memory budget in bytes; zero means no limit.
+ */
+  Deduplicator::Deduplicator(std::size_t budgetBytes) : dedupBudget(budgetBytes) {
+    if (dedupBudget == 0) {
+      resizeTable(1024);
+      return;
+    }
+    dedupBuffer = std::max<std::size_t>(1, std::min(merge_buffer, dedupBudget / 16 / sizeof(PuzzleRecord)));
+    std::size_t records = static_cast<std::size_t>(dedupBudget / 4 * 3 / sizeof(PuzzleRecord) * max_load);
+    resizeBloom(records * (max_runs + 1));
+    fitTable();
+  }
+
+/**
+ * @brief Unmaps the runs and closes their (unlinked) files.
+ */
+  Deduplicator::~Deduplicator() {
+    for (Run &run : dedupRuns) {
+      if (run.records != nullptr) {
+        ::munmap(const_cast<PuzzleRecord*>(run.records), run.count * sizeof(PuzzleRecord));
+      }
+      ::close(run.fd);
+    }
+  }
+
+/**
+ * @brief Hashes a record.
+ *
+ * @param rec The record to hash.
+ * @return A 64-bit hash of the record.
+ */
+  std::uint64_t Deduplicator::hash(const PuzzleRecord &rec) {
+    std::uint64_t a = 0;
+    std::uint32_t b = 0;
+    std::memcpy(&a, rec.heads, 8);
+    std::memcpy(&b, rec.heads + 8, 2);
+    b |= std::uint32_t(rec.vertical) << 16;
+    return mix(a ^ mix(b + 0x9E3779B97F4A7C15ull));
+  }
+
+/**
+ * @brief Checks the Bloom filter.
+ *
+ * @param h The hash of a record.
+ * @return False if the record was certainly never inserted.
+ */
+  bool Deduplicator::bloomTest(std::uint64_t h) const {
+    const std::uint64_t *block = &dedupBloom[(h % (dedupBloom.size() / bloom_block_words)) * bloom_block_words];
+    std::uint64_t bits = mix(h);
+    for (int i = 0; i < bloom_probes; i++, bits >>= 9) {
+      if (i == 7) {
+        bits = mix(bits ^ h);
+      }
+      unsigned bit = unsigned(bits & 511);
+      if (not (block[bit >> 6] & (1ull << (bit & 63)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+/**
+ * @brief Adds a record hash to the Bloom filter; same probes as bloomTest.
+ *
+ * @param h The hash of the record.
+ */
+  void Deduplicator::bloomAdd(std::uint64_t h) {
+    std::uint64_t *block = &dedupBloom[(h % (dedupBloom.size() / bloom_block_words)) * bloom_block_words];
+    std::uint64_t bits = mix(h);
+    for (int i = 0; i < bloom_probes; i++, bits >>= 9) {
+      if (i == 7) {
+        bits = mix(bits ^ h);
+      }
+      unsigned bit = unsigned(bits & 511);
+      block[bit >> 6] |= 1ull << (bit & 63);
+    }
+  }
+
+/**
+ * @brief Replaces the Bloom filter with an empty one sized for a number of records.
+ *
+ * The filter never takes more than a quarter of the budget; its bits must be added
+ * again by the caller.
+ *
+ * @param records The number of records the filter should hold.
+ */
+  void Deduplicator::resizeBloom(std::size_t records) {
+    std::size_t block = bloom_block_words * sizeof(std::uint64_t);
+    std::size_t bytes = std::min(dedupBudget / 4, records * bloom_bits / 8);
+    dedupBloom.clear();
+    dedupBloom.shrink_to_fit();
+    dedupBloom.assign(std::max<std::size_t>(1, bytes / block) * bloom_block_words, 0);
+  }
+
+/**
+ * @brief Reallocates the exact table with a number of slots, keeping its records.
+ *
+ * @param slots The new number of slots, a power of two.
+ */
+  void Deduplicator::resizeTable(std::size_t slots) {
+    std::vector<PuzzleRecord> old;
+    old.swap(dedupTable);
+    PuzzleRecord empty;
+    empty.vertical = free_slot;
+    dedupTable.assign(slots, empty);
+    dedupLimit = static_cast<std::size_t>(slots * max_load);
+    dedupUsed = 0;
+    for (const PuzzleRecord &rec : old) {
+      if (rec.vertical != free_slot) {
+        tableInsert(rec, hash(rec));
+      }
+    }
+  }
+
+/**
+ * @brief Sizes the (empty) exact table to the budget left by the filter, the fence keys
+ * and the merge buffer, as a power of two of at least 16 slots.
+ */
+  void Deduplicator::fitTable() {
+    std::size_t used = dedupBloom.size() * sizeof(std::uint64_t) + fenceBytes() + dedupBuffer * sizeof(PuzzleRecord);
+    std::size_t room = dedupBudget > used ? dedupBudget - used : 0;
+    std::size_t slots = 16;
+    while (slots * 2 * sizeof(PuzzleRecord) <= room) {
+      slots *= 2;
+    }
+    if (slots != dedupTable.size()) {
+      resizeTable(slots);
+    }
+  }
+
+/**
+ * @brief Returns the memory taken by the fence keys of every run.
+ *
+ * @return The size of the fence keys, in bytes.
+ */
+  std::size_t Deduplicator::fenceBytes() const {
+    std::size_t bytes = 0;
+    for (const Run &run : dedupRuns) {
+      bytes += run.fence.size() * sizeof(PuzzleRecord);
+    }
+    return bytes;
+  }
+
+/**
+ * @brief Inserts a record in the exact table (linear probing).
+ *
+ * @param rec The record.
+ * @param h The hash of the record.
+ * @return True if the record was not in the table.
+ */
+  bool Deduplicator::tableInsert(const PuzzleRecord &rec, std::uint64_t h) {
+    std::size_t mask = dedupTable.size() - 1;
+    std::size_t i = h & mask;
+    while (dedupTable[i].vertical != free_slot) {
+      if (dedupTable[i] == rec) {
+        return false;
+      }
+      i = (i + 1) & mask;
+    }
+    dedupTable[i] = rec;
+    dedupUsed++;
+    return true;
+  }
+
+/**
+ * @brief Looks a record up in the exact table.
+ *
+ * @param rec The record.
+ * @param h The hash of the record.
+ * @return True if the record is in the table.
+ */
+  bool Deduplicator::tableContains(const PuzzleRecord &rec, std::uint64_t h) const {
+    std::size_t mask = dedupTable.size() - 1;
+    std::size_t i = h & mask;
+    while (dedupTable[i].vertical != free_slot) {
+      if (dedupTable[i] == rec) {
+        return true;
+      }
+      i = (i + 1) & mask;
+    }
+    return false;
+  }
+
+/**
+ * @brief Creates an empty run on an anonymous temporary file.
+ *
+ * The file is unlinked right away, so it disappears with the process.
+ *
+ * @param stride The number of records per fence key.
+ * @return The run, ready for appendRun().
+ */
+  Deduplicator::Run Deduplicator::createRun(std::size_t stride) {
+    std::string path = (std::filesystem::temp_directory_path() / "bpg-dedup-XXXXXX").string();
+    Run run;
+    run.fd = ::mkstemp(path.data());
+    if (run.fd < 0) {
+      throw std::runtime_error("Error trying to create spill file: " + path);
+    }
+    ::unlink(path.c_str());
+    run.stride = stride;
+    return run;
+  }
+
+/**
+ * @brief Writes records at the end of a run, keeping a fence key every stride records.
+ *
+ * @param run The run, not yet finished.
+ * @param records The records, in increasing order and after those already written.
+ * @param count The number of records.
+ */
+  void Deduplicator::appendRun(Run &run, const PuzzleRecord *records, std::size_t count) {
+    for (std::size_t i = (run.stride - run.count % run.stride) % run.stride; i < count; i += run.stride) {
+      run.fence.push_back(records[i]);
+    }
+    std::size_t bytes = count * sizeof(PuzzleRecord);
+    const char *data = reinterpret_cast<const char*>(records);
+    for (std::size_t done = 0; done < bytes;) {
+      ssize_t n = ::write(run.fd, data + done, bytes - done);
+      if (n <= 0) {
+        ::close(run.fd);
+        throw std::runtime_error("Error trying to write spill file");
+      }
+      done += std::size_t(n);
+    }
+    run.count += count;
+  }
+
+/**
+ * @brief Maps a run once all its records are written.
+ *
+ * @param run The run.
+ */
+  void Deduplicator::finishRun(Run &run) {
+    if (run.count == 0) {
+      return;
+    }
+    void *addr = ::mmap(nullptr, run.count * sizeof(PuzzleRecord), PROT_READ, MAP_SHARED, run.fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(run.fd);
+      throw std::runtime_error("Error trying to map spill file");
+    }
+    run.records = static_cast<const PuzzleRecord*>(addr);
+  }
+
+/**
+ * @brief Moves the exact table to disk as a sorted run and empties it.
+ *
+ * The records are sorted in place at the front of the table, so a spill needs no
+ * memory besides the table itself. The fence keys of the new run take room from the
+ * table, which shrinks if the budget requires it.
+ */
+  void Deduplicator::spill() {
+    auto end = std::remove_if(dedupTable.begin(), dedupTable.end(),
+                              [](const PuzzleRecord &rec) { return rec.vertical == free_slot; });
+    std::sort(dedupTable.begin(), end);
+    Run run = createRun(fence_stride);
+    appendRun(run, dedupTable.data(), std::size_t(end - dedupTable.begin()));
+    finishRun(run);
+    dedupRuns.push_back(std::move(run));
+    dedupSpills++;
+    PuzzleRecord empty;
+    empty.vertical = free_slot;
+    std::fill(dedupTable.begin(), dedupTable.end(), empty);
+    dedupUsed = 0;
+    if (dedupRuns.size() > max_runs) {
+      mergeRuns();
+    }
+    fitTable();
+  }
+
+/**
+ * @brief Merges every run into a single one (k-way merge of the mapped runs).
+ *
+ * Records go straight from the mapped runs to the new file through a small buffer,
+ * and the fence keys are taken as they are written; the stride grows so that the keys
+ * never take more than a quarter of the budget. The Bloom filter is rebuilt on the way,
+ * sized for the records kept plus those the next runs will bring. Only called right
+ * after a spill, when the exact table is empty.
+ */
+  void Deduplicator::mergeRuns() {
+    using cursor = std::pair<PuzzleRecord, std::size_t>;   // record, run
+    auto later = [](const cursor &a, const cursor &b) { return b.first < a.first; };
+    std::priority_queue<cursor, std::vector<cursor>, decltype(later)> heap(later);
+    std::vector<std::size_t> next(dedupRuns.size(), 0);
+    std::size_t total = 0;
+    for (std::size_t r = 0; r < dedupRuns.size(); r++) {
+      total += dedupRuns[r].count;
+      if (dedupRuns[r].count > 0) {
+        heap.push({ dedupRuns[r].records[0], r });
+        next[r] = 1;
+      }
+    }
+    std::size_t stride = fence_stride;
+    while ((total / stride + 1) * sizeof(PuzzleRecord) > dedupBudget / 4) {
+      stride *= 2;
+    }
+    resizeBloom(total + max_runs * dedupLimit);
+
+    Run run = createRun(stride);
+    std::vector<PuzzleRecord> buffer;
+    buffer.reserve(dedupBuffer);
+    while (not heap.empty()) {
+      auto [rec, r] = heap.top();
+      heap.pop();
+      bloomAdd(hash(rec));
+      buffer.push_back(rec);
+      if (buffer.size() == dedupBuffer) {
+        appendRun(run, buffer.data(), buffer.size());
+        buffer.clear();
+      }
+      if (next[r] < dedupRuns[r].count) {
+        heap.push({ dedupRuns[r].records[next[r]++], r });
+      }
+    }
+    appendRun(run, buffer.data(), buffer.size());
+    finishRun(run);
+    for (Run &old : dedupRuns) {
+      if (old.records != nullptr) {
+        ::munmap(const_cast<PuzzleRecord*>(old.records), old.count * sizeof(PuzzleRecord));
+      }
+      ::close(old.fd);
+    }
+    dedupRuns.clear();
+    dedupRuns.push_back(std::move(run));
+  }
+
+/**
+ * @brief Looks a record up in a run.
+ *
+ * The fence keys narrow the search to one stride of the run, so a lookup touches
+ * a few pages of the mapped file at most.
+ *
+ * @param run The run.
+ * @param rec The record.
+ * @return True if the record is in the run.
+ */
+  bool Deduplicator::runContains(const Run &run, const PuzzleRecord &rec) const {
+    auto after = std::upper_bound(run.fence.begin(), run.fence.end(), rec);
+    if (after == run.fence.begin()) {
+      return false;
+    }
+    std::size_t first = std::size_t(after - run.fence.begin() - 1) * run.stride;
+    std::size_t last = std::min(run.count, first + run.stride);
+    return std::binary_search(run.records + first, run.records + last, rec);
+  }
+
+/**
+ * @brief Inserts a record if it was never inserted before.
+ *
+ * @param rec The record, usually a canonical one.
+ * @return True if the record is new, false if it is a duplicate.
+ */
+  bool Deduplicator::insert(const PuzzleRecord &rec) {
+    std::uint64_t h = hash(rec);
+    if (dedupBudget == 0) {
+      if (dedupUsed >= dedupLimit) {
+        resizeTable(dedupTable.size() * 2);
+      }
+      bool added = tableInsert(rec, h);
+      dedupSize += added ? 1 : 0;
+      return added;
+    }
+
+    if (bloomTest(h)) {
+      if (tableContains(rec, h)) {
+        return false;
+      }
+      for (const Run &run : dedupRuns) {
+        if (runContains(run, rec)) {
+          return false;
+        }
+      }
+    }
+    if (dedupUsed >= dedupLimit) {
+      spill();
+    }
+    tableInsert(rec, h);
+    bloomAdd(h);
+    dedupSize++;
+    return true;
+  }
+
+}
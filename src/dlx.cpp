@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <vector>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/dedup.h"
+#include "include/dlx.h"
+#include "include/store.h"
+
+namespace bpg{
+
+/**
+ * @brief Builds the exact-cover matrix for a board.
+ *
+ * Placements are listed with Puzzle::getShipBody and Puzzle::getShipShadow, so the
+ * engine follows the same rules as Puzzle::addShip, forbidden cells included.
+ * Submarines get a single placement per cell, since both orientations look the same.
+ *
+ * @param r The number of rows of the board.
+ * @param c The number of columns of the board.
+ * @param forbidden Cells no ship may cover.
+ */
+  DancingLinks::DancingLinks(int r, int c, const CellMask &forbidden) : dlxRows(r), dlxCols(c) {
+    Puzzle pz(c, r);
+    int columns = 1 + int(armada_size) + r * c;
+    dlxNodes.resize(columns);
+    dlxSize.assign(columns, 0);
+    dlxCovered.assign(columns, false);
+    dlxChosen.assign(armada_size, -1);
+
+    // Headers: the root is linked to the ship columns only; cell columns are secondary
+    // and stay out of the header list.
+    for (int i = 0; i < columns; i++) {
+      dlxNodes[i] = Node{ i, i, i, i, i, -1 };
+    }
+    for (int i = 0; i <= int(armada_size); i++) {
+      dlxNodes[i].left = (i == 0) ? int(armada_size) : i - 1;
+      dlxNodes[i].right = (i == int(armada_size)) ? 0 : i + 1;
+    }
+
+    dlxGroup.resize(armada_size);
+    for (std::size_t i = 0; i < armada_size; i++) {
+      bool same = i > 0 and pz.puzzleShips[i].shipType == pz.puzzleShips[i - 1].shipType;
+      dlxGroup[i] = same ? dlxGroup[i - 1] : int(i);
+    }
+
+    auto append = [&](int column, int row, int &first) {
+      int node = int(dlxNodes.size());
+      Node n{ node, node, dlxNodes[column].up, column, column, row };
+      dlxNodes.push_back(n);
+      dlxNodes[dlxNodes[column].up].down = node;
+      dlxNodes[column].up = node;
+      dlxSize[column]++;
+      if (first < 0) {
+        first = node;
+      } else {
+        dlxNodes[node].left = dlxNodes[first].left;
+        dlxNodes[node].right = first;
+        dlxNodes[dlxNodes[first].left].right = node;
+        dlxNodes[first].left = node;
+      }
+    };
+
+    for (std::size_t i = 0; i < armada_size; i++) {
+      Ship ship = pz.puzzleShips[i];
+      bool submarine = ship.shipType == cell_t::submarine;
+      for (short row = 0; row < r; row++) {
+        for (short col = 0; col < c; col++) {
+          for (int v = 0; v < (submarine ? 1 : 2); v++) {
+            ship.shipHeadCell = Cell(row, col);
+            if (not submarine) {
+              ship.shipOrientation = v ? Ship::orientation::V : Ship::orientation::H;
+            }
+            auto body = pz.getShipBody(ship);
+            if (int(body.size()) != ship.shipSize
+                or std::any_of(body.begin(), body.end(), [&](const Cell &b) { return forbidden[b.row] & (1u << b.col); })) {
+              continue;
+            }
+            Placement p{ int(i), ship, row * c + col, {} };
+            for (const Cell &cell : pz.getShipShadow(ship)) {
+              p.shadow.push_back(cellColumn(cell.row, cell.col));
+            }
+            int id = int(dlxPlacements.size());
+            dlxPlacements.push_back(p);
+
+            int first = -1;
+            append(shipColumn(int(i)), id, first);
+            for (const Cell &cell : body) {
+              append(cellColumn(cell.row, cell.col), id, first);
+            }
+          }
+        }
+      }
+    }
+  }
+
+/**
+ * @brief Removes a column from the header list and its rows from the other columns.
+ *
+ * @param column The column header to cover.
+ */
+  void DancingLinks::cover(int column) {
+    Node &h = dlxNodes[column];
+    dlxNodes[h.right].left = h.left;
+    dlxNodes[h.left].right = h.right;
+    for (int i = h.down; i != column; i = dlxNodes[i].down) {
+      for (int j = dlxNodes[i].right; j != i; j = dlxNodes[j].right) {
+        dlxNodes[dlxNodes[j].down].up = dlxNodes[j].up;
+        dlxNodes[dlxNodes[j].up].down = dlxNodes[j].down;
+        dlxSize[dlxNodes[j].column]--;
+      }
+    }
+  }
+
+/**
+ * @brief Undoes cover(), in the exact reverse order.
+ *
+ * @param column The column header to uncover.
+ */
+  void DancingLinks::uncover(int column) {
+    Node &h = dlxNodes[column];
+    for (int i = h.up; i != column; i = dlxNodes[i].up) {
+      for (int j = dlxNodes[i].left; j != i; j = dlxNodes[j].left) {
+        dlxSize[dlxNodes[j].column]++;
+        dlxNodes[dlxNodes[j].down].up = j;
+        dlxNodes[dlxNodes[j].up].down = j;
+      }
+    }
+    dlxNodes[h.right].left = column;
+    dlxNodes[h.left].right = column;
+  }
+
+/**
+ * @brief Checks the symmetry-breaking rule of a placement.
+ *
+ * Ships of the same type are interchangeable, so their head cells must come in
+ * increasing row-major order along the armada. Each layout is then found only once.
+ *
+ * @param p The placement to check.
+ * @return True if the placement keeps the heads of its type in order.
+ */
+  bool DancingLinks::allowed(const Placement &p) const {
+    for (int j = p.ship - 1; j >= dlxGroup[p.ship]; j--) {
+      if (dlxChosen[j] >= 0) {
+        if (dlxPlacements[dlxChosen[j]].head >= p.head) {
+          return false;
+        }
+        break;
+      }
+    }
+    for (int j = p.ship + 1; j < int(armada_size) and dlxGroup[j] == dlxGroup[p.ship]; j++) {
+      if (dlxChosen[j] >= 0) {
+        if (dlxPlacements[dlxChosen[j]].head <= p.head) {
+          return false;
+        }
+        break;
+      }
+    }
+    return true;
+  }
+
+/**
+ * @brief Algorithm X: picks the ship with fewest placements left and tries each of them.
+ *
+ * @param pz Scratch puzzle used to build the records of complete layouts.
+ * @param pzKeys The duplicate check holding the canonical records of generated puzzles.
+ * @param store The store receiving the generated puzzles.
+ */
+  void DancingLinks::search(Puzzle &pz, Deduplicator &pzKeys, PuzzleStore &store) {
+    if (dlxNodes[root()].right == root()) {
+      for (std::size_t i = 0; i < armada_size; i++) {
+        pz.puzzleShips[i] = dlxPlacements[dlxChosen[i]].placement;
+      }
+      PuzzleRecord rec = PuzzleRecord::fromPuzzle(pz);
+      if (pzKeys.insert(rec.canonical())) {
+        store.push(rec);
+        dlxDone = store.size() >= dlxLimit;
+      }
+      return;
+    }
+
+    int column = dlxNodes[root()].right;
+    for (int c = dlxNodes[column].right; c != root(); c = dlxNodes[c].right) {
+      if (dlxSize[c] < dlxSize[column]) {
+        column = c;
+      }
+    }
+    if (dlxSize[column] == 0) {
+      return;
+    }
+
+    cover(column);
+    for (int r = dlxNodes[column].down; r != column and not dlxDone; r = dlxNodes[r].down) {
+      const Placement &p = dlxPlacements[dlxNodes[r].row];
+      if (not allowed(p)) {
+        continue;
+      }
+      dlxChosen[p.ship] = dlxNodes[r].row;
+      std::vector<int> blocked;
+      for (int cell : p.shadow) {
+        if (not dlxCovered[cell]) {
+          dlxCovered[cell] = true;
+          cover(cell);
+          blocked.push_back(cell);
+        }
+      }
+      search(pz, pzKeys, store);
+      for (auto it = blocked.rbegin(); it != blocked.rend(); ++it) {
+        uncover(*it);
+        dlxCovered[*it] = false;
+      }
+      dlxChosen[p.ship] = -1;
+    }
+    uncover(column);
+  }
+
+/**
+ * @brief Enumerates layouts until `limit` distinct puzzles are found or none are left.
+ *
+ * @param limit The number of puzzles wanted.
+ * @param pzKeys The duplicate check holding the canonical records of generated puzzles.
+ * @param store The store receiving the generated puzzles.
+ */
+  void DancingLinks::solve(std::size_t limit, Deduplicator &pzKeys, PuzzleStore &store) {
+    Puzzle pz(dlxCols, dlxRows);
+    dlxLimit = limit;
+    dlxDone = store.size() >= limit;
+    search(pz, pzKeys, store);
+  }
+
+/**
+ * @brief Generates a list of puzzles with the Dancing Links engine.
+ *
+ * Same contract as generate(): the puzzles are distinct, valid and always come out
+ * in the same order for the same options. Forbidden cells are honoured; required
+ * cells are not, which is why `--constraints` is rejected with `--engine=dlx`.
+ *
+ * @param opt The running options determining the generation process.
+ * @return A store with the generated puzzles.
+ */
+  PuzzleStore Generator::generateDlx(const RunningOpt &opt) {
+    Deduplicator pzKeys(opt.dedup_budget_kb * 1024);
+    PuzzleStore store(opt.rows, opt.cols, opt.n_puzzles);
+    DancingLinks(opt.rows, opt.cols, opt.forbidden).solve(opt.n_puzzles, pzKeys, store);
+    return store;
+  }
+
+}
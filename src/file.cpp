@@ -3,52 +3,101 @@
 #include <fstream>
 #include <sstream>
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
 
+#include "include/blockfile.h"
 #include "include/bpg.h"
 #include "include/common.h"
+#include "include/file.h"
+#include "include/hints.h"
+#include "include/store.h"
+#include "include/validator.h"
 
 namespace bpg{
     /*!
-        * Saves content into a file.
-        * @param FileName The name of the file to save the content.
-        * @param content The content to be saved into the file.
-        * @return True if the content was successfully saved, false otherwise.
+    * Generates the text of a puzzle in Armada type, as saved in the armada file.
+    * @param puzzle The puzzle, with its armada already generated.
+    * @param rowAndCol The "rows cols" line of the puzzles.
+    * @param hints The hints of the puzzle, written as a "hints" line; null for none.
+    * @return The lines of the puzzle, each one ending in a newline.
     */
-    bool saveInFile(const std::string &FileName, const std::string &content) {
-        std::ofstream arquivo(FileName.c_str(), std::ios_base::app); // Abrindo o arquivo em modo de acrescentar (append)
-        if (!arquivo.is_open()) {
-            std::cerr << "Error trying to open file: " << FileName << std::endl;
-            return false;
+    std::string ArmadaText(const Puzzle &puzzle, const std::string &rowAndCol, const HintSet *hints) {
+        std::string text = rowAndCol + '\n';
+        size_t start = 0, end;
+        while ((end = puzzle.puzzleArmada.find('-', start)) != std::string::npos) {
+            text += puzzle.puzzleArmada.substr(start, end - start);
+            text += '\n';
+            start = end + 1; // Avança para o próximo caractere após o delimitador
+        }
+        if (hints != nullptr) {
+            text += "hints " + std::to_string(hints->size());
+            for (const Hint &hint : *hints) {
+                text += ' ' + std::to_string(hint.row) + ' ' + std::to_string(hint.col) + ' ' + static_cast<char>(hint.kind);
+            }
+            text += '\n';
+        }
+        text += " \n\n";
+        return text;
+    }
+
+#ifdef BPG_HAS_ZLIB
+    /*!
+    * Reports the result of a compressed write.
+    * @param FileName The name of the block file.
+    * @param report The sizes and time of the write.
+    */
+    void PrintCompression(const std::string &FileName, const CompressionReport &report) {
+        if (report.compressedBytes == 0) {
+            return;
         }
-        arquivo << content; // Escrevendo o conteúdo no arquivo
-        arquivo << '\n';
-        arquivo.close(); // Fechando o arquivo
-        return true;
+        double ratio = double(report.rawBytes) / double(report.compressedBytes);
+        double rate = report.elapsed_ms > 0 ? report.rawBytes / (report.elapsed_ms * 1e3) : 0;
+        std::cout << ">>> " << FileName << ": " << report.rawBytes << " -> " << report.compressedBytes
+                  << " bytes (" << ratio << "x) in " << report.blocks << " blocks, " << rate << " MB/s" << std::endl;
     }
+#endif
 
     /*!
     * Saves the puzzles in Armada type to a file.
-    * @param run_opt The running options containing the number of puzzles.
-    * @param puzzleList The list of puzzles to be saved.
+    * @param run_opt The running options containing the number of puzzles; with
+    *                run_opt.compress, a block file replaces the plain one.
+    * @param store The puzzles to be saved. Their armadas are materialized one at a time.
+    * @param hints The hints of each puzzle; empty to save the puzzles without hints.
     */
-    void SaveArmada(const RunningOpt &run_opt, std::list<Puzzle> puzzleList) {
-        std::string NumberOfPuzzles = std::to_string(run_opt.n_puzzles);
+    void SaveArmada(const RunningOpt &run_opt, const PuzzleStore &store, const std::vector<HintSet> &hints) {
+        std::string NumberOfPuzzles = std::to_string(store.size());
 
         std::string rowAndCol;
         std::stringstream ss;
         ss << run_opt.rows << ' ' << run_opt.cols;
         rowAndCol = ss.str();
 
-        saveInFile("../output/puzzles_armada.bp", NumberOfPuzzles);
-        std::list<Puzzle>::iterator it;
-        for (it = puzzleList.begin(); it != puzzleList.end(); ++it) {
-            saveInFile("../output/puzzles_armada.bp", rowAndCol);
-            size_t start = 0, end;
-            while ((end = it->puzzleArmada.find('-', start)) != std::string::npos) {
-                saveInFile("../output/puzzles_armada.bp", it->puzzleArmada.substr(start, end - start));
-                start = end + 1; // Avança para o próximo caractere após o delimitador
-            }
-            saveInFile("../output/puzzles_armada.bp", " \n");
+#ifdef BPG_HAS_ZLIB
+        if (run_opt.compress) {
+            std::string FileName = BlockFileName(run_opt.armada_file);
+            PrintCompression(FileName, SaveBlocks(FileName, NumberOfPuzzles + '\n', store.size(), run_opt.rows, run_opt.cols,
+                [&](size_t i, Puzzle &pz, std::string &out) {
+                    store.materialize(i, pz);
+                    out = ArmadaText(pz, rowAndCol, hints.empty() ? nullptr : &hints[i]);
+                }));
+            return;
+        }
+#endif
+
+        std::ofstream arquivo(run_opt.armada_file.c_str(), std::ios_base::app);
+        if (!arquivo.is_open()) {
+            std::cerr << "Error trying to open file: " << run_opt.armada_file << std::endl;
+            return;
+        }
+        arquivo << NumberOfPuzzles << '\n';
+        Puzzle pz(run_opt.cols, run_opt.rows);
+        for (size_t i = 0; i < store.size(); ++i) {
+            store.materialize(i, pz);
+            arquivo << ArmadaText(pz, rowAndCol, hints.empty() ? nullptr : &hints[i]);
         }
     }
 
@@ -166,13 +215,64 @@ namespace bpg{
         return stringfication;
     }
 
+    /*!
+    * Generates the puzzle a player sees: the hinted cells, with the number of ship
+    * cells of each row on the right and of each column below.
+    *
+    * @param puzzle The solution of the puzzle.
+    * @param hints The revealed cells.
+    * @param run_opt The running options containing the dimensions of the puzzle.
+    *
+    * @return A string representing the puzzle in matrix format.
+    */
+    std::string HintString(Puzzle &puzzle, const HintSet &hints, const RunningOpt &run_opt){
+        std::vector<std::string> cells(run_opt.rows * run_opt.cols, " ");
+        for (const Hint &hint : hints) {
+            std::string &cell = cells[hint.row * run_opt.cols + hint.col];
+            switch (hint.kind) {
+                case hint_t::water:     cell = "\u00B7"; break;   // ·
+                case hint_t::submarine: cell = "\u25CF"; break;   // ●
+                case hint_t::left:      cell = "\u25C0"; break;   // ◀
+                case hint_t::right:     cell = "\u25B6"; break;   // ▶
+                case hint_t::top:       cell = "\u25B2"; break;   // ▲
+                case hint_t::bottom:    cell = "\u25BC"; break;   // ▼
+                case hint_t::middle:    cell = "\u25FC"; break;   // ◼
+            }
+        }
+        std::vector<int> rowCount(run_opt.rows, 0), colCount(run_opt.cols, 0);
+        for (const Ship &ship : puzzle.puzzleShips) {
+            for (const Cell &cell : puzzle.getShipBody(ship)) {
+                rowCount[cell.row]++;
+                colCount[cell.col]++;
+            }
+        }
+
+        std::stringstream oss;
+        oss << "hints " << hints.size() << "\n";
+        for (int r = 0; r < run_opt.rows; r++) {
+            oss << (r + 1 < 10 ? " " : "") << r + 1 << "[ ";
+            for (int c = 0; c < run_opt.cols; c++) {
+                oss << cells[r * run_opt.cols + c] << " ";
+            }
+            oss << "] " << rowCount[r] << "\n";
+        }
+        oss << "    ";
+        for (int c = 0; c < run_opt.cols; c++) {
+            oss << colCount[c] << " ";
+        }
+        oss << "\n";
+        return oss.str();
+    }
+
     /*!
     * Saves the matrix puzzles to a file.
-    * @param run_opt The running options containing the number of puzzles and dimensions.
-    * @param puzzleList The list of puzzles to be saved.
+    * @param run_opt The running options containing the number of puzzles and dimensions; with
+    *                run_opt.compress, a block file replaces the plain one.
+    * @param store The puzzles to be saved. Their boards are materialized one at a time.
+    * @param hints The hints of each puzzle; when given, each solution is followed by its puzzle.
     */
-    void SaveMatrix(const RunningOpt &run_opt, std::list<Puzzle> puzzleList) {
-        std::string NumberOfPuzzles = std::to_string(run_opt.n_puzzles);
+    void SaveMatrix(const RunningOpt &run_opt, const PuzzleStore &store, const std::vector<HintSet> &hints) {
+        std::string NumberOfPuzzles = std::to_string(store.size());
 
         std::string rowAndCol;
         std::stringstream ss;
@@ -182,16 +282,229 @@ namespace bpg{
         std:: string numOfCols = FirstLineMatrix(run_opt);
         std:: string numOfCols2 = SecondLineMatrix(run_opt);
 
-        saveInFile("../output/puzzles_matrix.bp", NumberOfPuzzles);
-        std::list<Puzzle>::iterator it;
-        for (it = puzzleList.begin(); it != puzzleList.end(); ++it) {
-            saveInFile("../output/puzzles_matrix.bp", rowAndCol);
-            if (run_opt.cols>9){
-                saveInFile("../output/puzzles_matrix.bp", numOfCols);
+        // Every puzzle starts with the same header lines.
+        std::string header = rowAndCol + '\n';
+        if (run_opt.cols>9){
+            header += numOfCols + '\n';
+        }
+        header += numOfCols2 + '\n';
+
+#ifdef BPG_HAS_ZLIB
+        if (run_opt.compress) {
+            std::string FileName = BlockFileName(run_opt.matrix_file);
+            PrintCompression(FileName, SaveBlocks(FileName, NumberOfPuzzles + '\n', store.size(), run_opt.rows, run_opt.cols,
+                [&](size_t i, Puzzle &pz, std::string &out) {
+                    store.materialize(i, pz);
+                    out = header + MatrixString(pz, run_opt) + '\n';
+                    if (!hints.empty()) {
+                        out += HintString(pz, hints[i], run_opt) + '\n';
+                    }
+                }));
+            return;
+        }
+#endif
+
+        std::ofstream arquivo(run_opt.matrix_file.c_str(), std::ios_base::app);
+        if (!arquivo.is_open()) {
+            std::cerr << "Error trying to open file: " << run_opt.matrix_file << std::endl;
+            return;
+        }
+        arquivo << NumberOfPuzzles << '\n';
+        Puzzle pz(run_opt.cols, run_opt.rows);
+        for (size_t i = 0; i < store.size(); ++i) {
+            store.materialize(i, pz);
+            arquivo << header << MatrixString(pz,run_opt) << '\n';
+            if (!hints.empty()) {
+                arquivo << HintString(pz, hints[i], run_opt) << '\n';
+            }
+        }
+    }
+
+    /*!
+    * Reads the puzzles of an armada file, as written by SaveArmada or edited by hand.
+    *
+    * Each puzzle starts with a "rows cols" line, followed by its ship lines
+    * `<type> <row> <col> <H|V>` (submarines may leave out the orientation). Ships may
+    * come in any order; they are rearranged into the armada order. Puzzles that cannot
+    * be represented (unknown ships, wrong armada, missing fields or orientations,
+    * coordinates out of the 16x16 range) are returned with their error already set.
+    *
+    * @param FileName The name of the armada file, plain or block-compressed.
+    * @return The layouts found in the file.
+    */
+    std::vector<ArmadaLayout> ReadArmada(const std::string &FileName) {
+#ifdef BPG_HAS_ZLIB
+        if (IsBlockFile(FileName)) {
+            std::string text;
+            if (!ReadBlockFile(FileName, text)) {
+                std::cerr << "Error trying to read file: " << FileName << std::endl;
+                return {};
+            }
+            std::istringstream unpacked(text);
+            return ParseArmada(unpacked);
+        }
+#endif
+        std::ifstream arquivo(FileName.c_str());
+        if (!arquivo.is_open()) {
+            std::cerr << "Error trying to open file: " << FileName << std::endl;
+            return {};
+        }
+        return ParseArmada(arquivo);
+    }
+
+    /*!
+    * Parses puzzles in Armada type; see ReadArmada.
+    *
+    * @param arquivo The stream holding the puzzles.
+    * @return The layouts found in the stream.
+    */
+    std::vector<ArmadaLayout> ParseArmada(std::istream &arquivo) {
+        std::vector<ArmadaLayout> layouts;
+
+        // Ships of the current puzzle, grouped by type (B, D, C, S).
+        std::vector<Ship> ships;
+        auto flush = [&]() {
+            if (layouts.empty()) {
+                return;
+            }
+            ArmadaLayout &layout = layouts.back();
+            std::stable_sort(ships.begin(), ships.end(), [](const Ship &a, const Ship &b) {
+                return a.shipType < b.shipType;
+            });
+            Puzzle expected(layout.cols, layout.rows);
+            if (ships.size() != armada_size && layout.error == layout_error::none) {
+                layout.error = layout_error::bad_armada;
+            }
+            for (size_t i = 0; i < ships.size() && layout.error == layout_error::none; i++) {
+                if (ships[i].shipType != expected.puzzleShips[i].shipType) {
+                    layout.error = layout_error::bad_armada;
+                } else {
+                    expected.puzzleShips[i] = ships[i];
+                }
+            }
+            if (layout.error == layout_error::none) {
+                layout.record = PuzzleRecord::fromPuzzle(expected);
             }
-            saveInFile("../output/puzzles_matrix.bp", numOfCols2);
+            ships.clear();
+        };
 
-            saveInFile("../output/puzzles_matrix.bp", MatrixString(*it,run_opt));
+        std::string line;
+        while (std::getline(arquivo, line)) {
+            std::stringstream ss(line);
+            std::string first;
+            if (!(ss >> first)) {
+                continue;
+            }
+            if (std::isdigit(static_cast<unsigned char>(first[0]))) {
+                short cols = 0;
+                if (!(ss >> cols)) {   // A lone number is the puzzle count of a (concatenated) file.
+                    continue;
+                }
+                flush();
+                ArmadaLayout layout;
+                layout.rows = static_cast<short>(std::atoi(first.c_str()));
+                layout.cols = cols;
+                if (layout.rows < min_rows || layout.rows > max_rows || layout.cols < min_cols || layout.cols > max_cols) {
+                    layout.error = layout_error::bad_armada;
+                }
+                layouts.push_back(layout);
+                continue;
+            }
+            if (layouts.empty() || first == "hints") {   // Hints do not change the layout.
+                continue;
+            }
+            // `<type> <row> <col> <H|V>`; a submarine may leave out its orientation.
+            std::string types{ "BDCS" };
+            int row = -1, col = -1;
+            std::string orient, extra;
+            size_t t = types.find(first[0]);
+            bool read = static_cast<bool>(ss >> row >> col);
+            ss >> orient >> extra;
+            bool oriented = orient == "H" || orient == "V" || (orient.empty() && first == "S");
+            if (first.size() != 1 || t == std::string::npos || !read || !oriented || !extra.empty()) {
+                layouts.back().error = layout_error::bad_armada;
+                continue;
+            }
+            if (row < 0 || row >= max_rows || col < 0 || col >= max_cols) {
+                if (layouts.back().error == layout_error::none) {
+                    layouts.back().error = layout_error::out_of_bounds;
+                }
+                continue;
+            }
+            Ship ship(static_cast<cell_t>(t + 1), Cell(row, col), orient == "V" ? Ship::orientation::V : Ship::orientation::H);
+            ships.push_back(ship);
+        }
+        flush();
+        return layouts;
+    }
+
+    /*!
+    * Reads the cell constraints of a generation into run_opt.required and run_opt.forbidden.
+    *
+    * Each non-empty line (lines starting with `#` are comments) is one of
+    *   `ship <row> <col>`   a ship must cover the cell;
+    *   `water <row> <col>`  the cell must stay water;
+    *   `water row <row>`    the whole row must stay water;
+    *   `water col <col>`    the whole column must stay water.
+    * Rows and columns count from zero and must fit the board of run_opt.
+    *
+    * @param FileName The name of the constraints file.
+    * @param run_opt The running options with the board size; receives the masks.
+    */
+    void ReadConstraints(const std::string &FileName, RunningOpt &run_opt) {
+        std::ifstream arquivo(FileName.c_str());
+        if (!arquivo.is_open()) {
+            throw std::invalid_argument("Error trying to open file: " + FileName);
+        }
+        run_opt.required = {};
+        run_opt.forbidden = {};
+        const std::uint16_t fullRow = std::uint16_t((1u << run_opt.cols) - 1);
+        std::string line;
+        size_t lineCount = 0;
+        while (std::getline(arquivo, line)) {
+            lineCount++;
+            std::stringstream fields(line);
+            std::string kind, where;
+            if (!(fields >> kind) || kind[0] == '#') {
+                continue;
+            }
+            std::string at = FileName + ":" + std::to_string(lineCount);
+            if (kind != "ship" && kind != "water") {
+                throw std::invalid_argument("Syntax error in " + at);
+            }
+            int row = -1, col = -1;
+            if (kind == "water" && (fields >> where) && (where == "row" || where == "col")) {
+                int index;
+                if (!(fields >> index)) {
+                    throw std::invalid_argument("Syntax error in " + at);
+                }
+                (where == "row" ? row : col) = index;
+            } else {
+                fields.clear();
+                fields.str(line);
+                if (!(fields >> kind >> row >> col)) {
+                    throw std::invalid_argument("Syntax error in " + at);
+                }
+            }
+            if ((where != "col" && (row < 0 || row >= run_opt.rows)) || (where != "row" && (col < 0 || col >= run_opt.cols))) {
+                throw std::invalid_argument("Cell outside the board in " + at);
+            }
+            if (where == "row") {
+                run_opt.forbidden[row] = fullRow;
+            } else if (where == "col") {
+                for (int r = 0; r < run_opt.rows; r++) {
+                    run_opt.forbidden[r] |= std::uint16_t(1u << col);
+                }
+            } else if (kind == "water") {
+                run_opt.forbidden[row] |= std::uint16_t(1u << col);
+            } else {
+                run_opt.required[row] |= std::uint16_t(1u << col);
+            }
+        }
+        for (int r = 0; r < run_opt.rows; r++) {
+            if (run_opt.required[r] & run_opt.forbidden[r]) {
+                throw std::invalid_argument("A cell is both ship and water in " + FileName);
+            }
         }
     }
-}
\ No newline at end of file
+}
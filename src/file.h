@@ -3,13 +3,21 @@
 #include <fstream>
 #include <sstream>
 #include <list>
+#include <vector>
 
 #include "include/bpg.h"
 #include "include/common.h"
+#include "include/hints.h"
+#include "include/store.h"
+#include "include/validator.h"
 
 namespace bpg{
-    void SaveArmada(const RunningOpt &run_opt, std::list<Puzzle> puzzleList);
+    void SaveArmada(const RunningOpt &run_opt, const PuzzleStore &store, const std::vector<HintSet> &hints = {});
     std :: string SecondLineMatrix(const RunningOpt &run_opt);
     std::string MatrixString(Puzzle &puzzle, const RunningOpt &run_opt);
-    void SaveMatrix(const RunningOpt &run_opt, std::list<Puzzle> puzzleList);
+    std::string HintString(Puzzle &puzzle, const HintSet &hints, const RunningOpt &run_opt);
+    void SaveMatrix(const RunningOpt &run_opt, const PuzzleStore &store, const std::vector<HintSet> &hints = {});
+    std::vector<ArmadaLayout> ReadArmada(const std::string &FileName);
+    std::vector<ArmadaLayout> ParseArmada(std::istream &arquivo);
+    void ReadConstraints(const std::string &FileName, RunningOpt &run_opt);
 }
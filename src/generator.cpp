@@ -2,12 +2,161 @@
 #include <string>
 #include <sstream>
 #include <cstdlib> 
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
 
 #include "include/bpg.h"
 #include "include/common.h"
+#include "include/dedup.h"
+#include "include/store.h"
 
 namespace bpg{
 
+  namespace {
+    /// Nodes (placement attempts) of one unit of the restart schedule.
+    constexpr unsigned long restart_unit{ 2048 };
+
+    /**
+     * @brief Returns the i-th term (1-based) of the Luby sequence: 1 1 2 1 1 2 4 1 1 2 ...
+     */
+    unsigned long luby(unsigned long i) {
+      unsigned long k = 1;
+      while ((1ul << k) - 1 < i) {
+        k++;
+      }
+      while (i != (1ul << k) - 1) {
+        i -= (1ul << (k - 1)) - 1;
+        k = 1;
+        while ((1ul << k) - 1 < i) {
+          k++;
+        }
+      }
+      return 1ul << (k - 1);
+    }
+
+    /**
+     * @brief Shuffles the candidate placements of a ship for a new restart.
+     *
+     * Each candidate gets its row-major position plus a random jitter as sort key. The
+     * order stays close to the top-left-first scan of generateAux, which packs ships
+     * tightly and matters on small boards, while every restart explores a different
+     * part of the search tree.
+     */
+    void shuffleCandidates(std::vector<Ship> &candidates, short cols, std::mt19937 &rng) {
+      std::uniform_real_distribution<double> jitter(0.0, candidates.size() / 4.0);
+      std::vector<std::pair<double, Ship>> keyed;
+      keyed.reserve(candidates.size());
+      for (const Ship &ship : candidates) {
+        keyed.emplace_back(ship.shipHeadCell.row * cols + ship.shipHeadCell.col + jitter(rng), ship);
+      }
+      std::sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+      for (std::size_t i = 0; i < candidates.size(); i++) {
+        candidates[i] = keyed[i].second;
+      }
+    }
+
+    /// State shared by the randomized search of generateAnytime.
+    struct RestartSearch {
+      const RunningOpt &opt;
+      std::chrono::steady_clock::time_point deadline;
+      std::mt19937 rng;
+      std::vector<std::vector<Ship>> order; //!< Candidate placements of each ship, shuffled per restart.
+      Deduplicator &pzKeys;
+      PuzzleStore &store;
+      unsigned long nodes = 0;   //!< Nodes visited in the current restart.
+      unsigned long limit = 0;   //!< Node budget of the current restart.
+      bool restart = false;      //!< The budget of the current restart is exhausted.
+      bool stop = false;         //!< The deadline passed or every puzzle was found.
+    };
+
+    /**
+     * @brief Places ship `index` and the following ones in random order.
+     *
+     * Same rules as Generator::generateAux, but candidates are tried in the order
+     * shuffled for this restart.
+     */
+    void randomAux(std::size_t index, Puzzle &pz, RestartSearch &s) {
+      const std::vector<Ship> &candidates = s.order[index];
+
+      for (std::size_t k = 0; k < candidates.size(); k++) {
+        if (++s.nodes > s.limit) {
+          s.restart = true;
+        }
+        if ((s.nodes & 1023) == 0 and std::chrono::steady_clock::now() >= s.deadline) {
+          s.stop = true;
+        }
+        if (s.restart or s.stop) {
+          return;
+        }
+
+        Ship &ship = pz.puzzleShips[index];
+        ship = candidates[k];
+        if (not pz.addShip(ship)) {
+          continue;
+        }
+        if (not pz.canCoverRequired(index + 1)) {
+          pz.removeShip(ship);
+          continue;
+        }
+        if (index + 1 == pz.puzzleShips.size()) {
+          PuzzleRecord rec = PuzzleRecord::fromPuzzle(pz);
+          if (s.pzKeys.insert(rec.canonical())) {
+            s.store.push(rec);
+            s.stop = s.store.size() >= s.opt.n_puzzles;
+          }
+        } else {
+          randomAux(index + 1, pz, s);
+        }
+        pz.removeShip(ship);
+      }
+    }
+
+    /// State of the resumable search of Generator::generateAfter.
+    struct ResumeSearch {
+      std::vector<std::vector<Ship>> candidates; //!< Placements of each ship, in the order they are tried.
+      std::vector<std::size_t> cursor;           //!< Placement of each ship in the layout to resume after.
+      std::vector<std::size_t> chosen;           //!< Placement of each ship on the board.
+      std::size_t limit = 0;
+      PuzzleStore &store;
+    };
+
+    /**
+     * @brief Places ship `index` and the following ones, resuming after a cursor.
+     *
+     * Same-type ships take increasing placements, which keeps a single layout of each
+     * group of equivalent ones.
+     *
+     * @param tight True while the ships placed so far are those of the cursor.
+     */
+    void resumeAux(std::size_t index, Puzzle &pz, ResumeSearch &s, bool tight) {
+      const std::vector<Ship> &candidates = s.candidates[index];
+      std::size_t first = 0;
+      if (index > 0 and pz.puzzleShips[index].shipType == pz.puzzleShips[index - 1].shipType) {
+        first = s.chosen[index - 1] + 1;
+      }
+      bool last = index + 1 == pz.puzzleShips.size();
+      if (tight) {
+        first = std::max(first, s.cursor[index] + (last ? 1 : 0));
+      }
+      for (std::size_t k = first; k < candidates.size() and s.store.size() < s.limit; k++) {
+        Ship &ship = pz.puzzleShips[index];
+        ship = candidates[k];
+        if (not pz.addShip(ship)) {
+          continue;
+        }
+        s.chosen[index] = k;
+        if (last) {
+          s.store.push(pz);
+        } else {
+          resumeAux(index + 1, pz, s, tight and k == s.cursor[index]);
+        }
+        pz.removeShip(ship);
+      }
+    }
+  }
+
 /**
  * @brief Generates the next location in the puzzle grid.
  * 
@@ -63,11 +212,11 @@ Cell Generator::nextLocation(const Cell& current, Puzzle &pz) {
  * 
  * @param index The index of the ship being placed.
  * @param pz The puzzle object for which auxiliary puzzles are generated.
- * @param pzKeys A set containing keys of generated puzzles.
+ * @param pzKeys The duplicate check holding the canonical records of generated puzzles.
  * @param opt The running options determining the generation process.
- * @param puzzleList The list of generated puzzles.
+ * @param store The store receiving the generated puzzles.
  */
-  void Generator::generateAux(int index, Puzzle &pz, std::set<std::string> &pzKeys, const RunningOpt &opt, std::list<Puzzle> &puzzleList){
+  void Generator::generateAux(int index, Puzzle &pz, Deduplicator &pzKeys, const RunningOpt &opt, PuzzleStore &store){
     pz.puzzleShips[index].shipHeadCell = Cell(0, 0);
     pz.puzzleShips[index].shipChange_or = true;
 
@@ -85,23 +234,24 @@ Cell Generator::nextLocation(const Cell& current, Puzzle &pz) {
                   all_placed = false;
               }
           }
-          if(all_placed){
-            generateArmada(pz);
-            generatePuzzleKey(pz);
-            if(pzKeys.find(pz.puzzleKey) == pzKeys.end()){
-              pzKeys.insert(pz.puzzleKey); 
-              puzzleList.push_back(pz);
+          if(all_placed and pz.canCoverRequired(pz.puzzleShips.size())){
+            PuzzleRecord rec = PuzzleRecord::fromPuzzle(pz);
+            if(pzKeys.insert(rec.canonical())){
+              store.push(rec);
             }
-            if(static_cast<int>(pzKeys.size()) == opt.n_puzzles){
+            if(pzKeys.size() == opt.n_puzzles){
               return;
             }
           }
       }
       else{
-          if(puzzleList.size() == opt.n_puzzles){
+          if(store.size() == opt.n_puzzles){
             return;
           }
-          generateAux((index+1), pz, pzKeys, opt, puzzleList);
+          // Cut the branch as soon as a required cell is out of reach of the ships left.
+          if(pz.canCoverRequired(index + 1)){
+            generateAux((index+1), pz, pzKeys, opt, store);
+          }
       }
 
       pz.removeShip(pz.puzzleShips[index]);
@@ -125,19 +275,35 @@ Cell Generator::nextLocation(const Cell& current, Puzzle &pz) {
  * running options. It uses recursion to create
  * new puzzles by adding ships and exploring different ship orientations.
  * 
- * @param opt The running options determining the generation process.
- * @return A list of generated puzzles.
+ * Puzzles are kept as compact records; their keys and armadas are
+ * only produced when the store is materialized for output.
+ *
+ * Cells of opt.forbidden are never covered (Puzzle::addShip rejects them), and a
+ * branch is cut as soon as a cell of opt.required can no longer be covered.
+ *
+ * @param opt The running options determining the generation process; opt.engine
+ *            selects the Dancing Links engine instead.
+ * @return A store with the generated puzzles.
  */
-  std::list<Puzzle> Generator::generate(const RunningOpt &opt){
+  PuzzleStore Generator::generate(const RunningOpt &opt){
+    if (opt.engine == engine_t::dlx) {
+      return generateDlx(opt);
+    }
     Puzzle pz(opt.cols, opt.rows);
-    std::set<std::string> pzKeys;
-    std::list<Puzzle> puzzleList;
+    pz.setRequired(opt.required);
+    pz.puzzleForbidden = opt.forbidden;
+    Deduplicator pzKeys(opt.dedup_budget_kb * 1024);
+    PuzzleStore store(opt.rows, opt.cols, opt.n_puzzles);
 
     pz.puzzleShips[0].shipChange_or = true;
     while (pz.puzzleShips[0].shipHeadCell != pz.endLocation) {
       pz.puzzleShips[0].shipPlaced = pz.addShip(pz.puzzleShips[0]);
 
-      generateAux(1, pz, pzKeys, opt, puzzleList);
+      // A subtree without the battleship never yields a puzzle; with forbidden cells at the
+      // top of the board, it would be searched in full for every rejected position.
+      if (pz.puzzleShips[0].shipPlaced and pz.canCoverRequired(1)) {
+        generateAux(1, pz, pzKeys, opt, store);
+      }
 
       pz.removeShip(pz.puzzleShips[0]);
       if (pz.puzzleShips[0].shipChange_or) {
@@ -152,7 +318,132 @@ Cell Generator::nextLocation(const Cell& current, Puzzle &pz) {
       pz.puzzleShips[0].shipChange_or = true;
     }
 
-    return puzzleList;
+    return store;
+  }
+
+/**
+ * @brief Generates distinct puzzles until enough are found or the deadline passes.
+ * 
+ * The lexicographic search of generate() may spend a long time in a region of the
+ * search tree without any valid layout. This anytime version tries the placements
+ * of each ship in random order and restarts the search with a new order whenever
+ * its node budget runs out. Budgets follow the Luby sequence, so short and long runs
+ * are mixed. The set of keys is kept across restarts, so every puzzle is distinct.
+ * 
+ * The search also ends once a restart covers the whole tree, which on a board without
+ * any layout happens at once instead of at the deadline.
+ *
+ * @param opt The running options; opt.deadline_ms bounds the running time (zero for no bound).
+ * @param report Receives how many puzzles were found and how the search went.
+ * @return A store with the puzzles found, possibly fewer than requested.
+ */
+  PuzzleStore Generator::generateAnytime(const RunningOpt &opt, GenerationReport &report){
+    auto started = std::chrono::steady_clock::now();
+    Puzzle pz(opt.cols, opt.rows);
+    pz.setRequired(opt.required);
+    pz.puzzleForbidden = opt.forbidden;
+    Deduplicator pzKeys(opt.dedup_budget_kb * 1024);
+    PuzzleStore store(opt.rows, opt.cols, opt.n_puzzles);
+    unsigned int seed = opt.seed ? opt.seed : std::random_device{}();
+    auto deadline = opt.deadline_ms ? started + std::chrono::milliseconds(opt.deadline_ms)
+                                    : std::chrono::steady_clock::time_point::max();
+    RestartSearch s{ opt, deadline, std::mt19937(seed), {}, pzKeys, store };
+
+    // Every placement of every ship; submarines look the same in both orientations.
+    s.order.resize(pz.puzzleShips.size());
+    for (std::size_t i = 0; i < pz.puzzleShips.size(); i++) {
+      for (short r = 0; r < pz.puzzleRows; r++) {
+        for (short c = 0; c < pz.puzzleCols; c++) {
+          Ship ship = pz.puzzleShips[i];
+          ship.shipHeadCell = Cell(r, c);
+          if (ship.shipType == cell_t::submarine) {
+            s.order[i].push_back(ship);
+            continue;
+          }
+          ship.shipOrientation = Ship::orientation::H;
+          s.order[i].push_back(ship);
+          ship.shipOrientation = Ship::orientation::V;
+          s.order[i].push_back(ship);
+        }
+      }
+    }
+
+    bool exhausted = false;
+    while (not s.stop and std::chrono::steady_clock::now() < s.deadline) {
+      report.restarts++;
+      for (auto &candidates : s.order) {
+        shuffleCandidates(candidates, pz.puzzleCols, s.rng);
+      }
+      s.nodes = 0;
+      s.limit = luby(report.restarts) * restart_unit;
+      s.restart = false;
+      pz.clear();
+      randomAux(0, pz, s);
+      // A restart that ran out of neither budget nor deadline searched the whole tree,
+      // so every layout was found; a board without layouts stops here too.
+      if (not s.restart and not s.stop) {
+        exhausted = true;
+        break;
+      }
+    }
+
+    report.requested = opt.n_puzzles;
+    report.found = store.size();
+    report.deadline_hit = not exhausted and store.size() < opt.n_puzzles;
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return store;
+  }
+
+/**
+ * @brief Generates the puzzles that follow a given one in a fixed order.
+ *
+ * Every layout of the board comes exactly once: placements are numbered cell by cell in
+ * row-major order, horizontal before vertical, and ships of the same type take increasing
+ * placements, so equivalent layouts are skipped without a duplicate check. The search can
+ * start right after any layout it returned: the ships of the cursor are the first
+ * placements tried, so the search goes down their path and every layout up to the cursor
+ * is skipped without being visited. Puzzles can thus be taken in batches, as the pool
+ * does, at the cost of each batch only.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @param after The puzzle to resume after, as returned by a previous call; nullptr to start.
+ * @param n The number of puzzles wanted.
+ * @return A store with the next puzzles; fewer than `n` once every layout was visited.
+ */
+  PuzzleStore Generator::generateAfter(unsigned short rows, unsigned short cols, const PuzzleRecord *after, std::size_t n) {
+    Puzzle pz(cols, rows);
+    PuzzleStore store(rows, cols, n);
+    ResumeSearch s{ {}, {}, std::vector<std::size_t>(pz.puzzleShips.size(), 0), n, store };
+
+    // Placements are numbered cell by cell in row-major order, horizontal before vertical.
+    for (const Ship &model : pz.puzzleShips) {
+      std::vector<Ship> candidates;
+      for (short r = 0; r < pz.puzzleRows; r++) {
+        for (short c = 0; c < pz.puzzleCols; c++) {
+          Ship ship = model;
+          ship.shipHeadCell = Cell(r, c);
+          if (ship.shipType == cell_t::submarine) {
+            candidates.push_back(ship);
+            continue;
+          }
+          ship.shipOrientation = Ship::orientation::H;
+          candidates.push_back(ship);
+          ship.shipOrientation = Ship::orientation::V;
+          candidates.push_back(ship);
+        }
+      }
+      s.candidates.push_back(candidates);
+    }
+    if (after != nullptr) {
+      for (std::size_t i = 0; i < pz.puzzleShips.size(); i++) {
+        std::size_t cell = std::size_t((after->heads[i] >> 4) * cols + (after->heads[i] & 0x0F));
+        s.cursor.push_back(pz.puzzleShips[i].shipType == cell_t::submarine ? cell
+                                                                           : cell * 2 + ((after->vertical >> i) & 1u));
+      }
+    }
+    resumeAux(0, pz, s, after != nullptr);
+    return store;
   }
 
 /**
@@ -181,4 +472,51 @@ Cell Generator::nextLocation(const Cell& current, Puzzle &pz) {
     pz.puzzleArmada = ss.str();
   }
 
+
+/**
+ * @brief Rebuilds a puzzle from its armada configuration.
+ * 
+ * This function is the inverse of generateArmada: it reads the ships stored in
+ * the puzzle's armada string, places them on a clean board and regenerates the key.
+ * 
+ * @param pz The puzzle whose puzzleArmada is read and whose board, ships and key are rebuilt.
+ * @return True if every ship in the armada could be placed, false otherwise.
+ */
+  bool Generator::parseArmada(Puzzle &pz) {
+    pz.clear();
+    std::stringstream ss(pz.puzzleArmada);
+    std::string token;
+    int j = 0;
+
+    while (std::getline(ss, token, '-') and j < int(pz.puzzleShips.size())) {
+      std::stringstream fields(token);
+      char type;
+      short row, col;
+      char orient = 'U';
+      if (not (fields >> type >> row >> col)) {
+        return false;
+      }
+      fields >> orient;
+
+      Ship &ship = pz.puzzleShips[j];
+      if (Puzzle::cellToChar(ship.shipType) != type) {
+        return false;
+      }
+      ship.shipHeadCell = Cell(row, col);
+      if (ship.shipType != cell_t::submarine) {
+        ship.shipOrientation = (orient == 'V') ? Ship::orientation::V : Ship::orientation::H;
+      }
+      ship.shipPlaced = pz.addShip(ship);
+      if (not ship.shipPlaced) {
+        return false;
+      }
+      j++;
+    }
+    if (j != int(pz.puzzleShips.size())) {
+      return false;
+    }
+    generatePuzzleKey(pz);
+    return true;
+  }
+
 }
\ No newline at end of file
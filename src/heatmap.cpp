@@ -0,0 +1,529 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/heatmap.h"
+
+namespace bpg{
+
+  namespace {
+    constexpr unsigned long deadline_check_nodes{ 8 };
+    constexpr double max_exact_layouts{ 1e6 };   //!< Above this estimate, refresh() only samples before any shot.
+    constexpr std::size_t min_samples{ 100 };     //!< Fewer accepted samples make an unreliable heatmap.
+    constexpr double exact_share{ 0.6 };          //!< Share of the budget the exact count may take.
+  }
+
+/**
+ * @brief Lists every placement of the armada on a board and which ones conflict.
+ *
+ * @param rows The number of rows of the board.
+ * @param cols The number of columns of the board.
+ * @param threads The number of threads used by refresh(); zero for one per core.
+ * @param seed The seed of the sampler; zero picks a random seed.
+ */
+  HeatmapEngine::HeatmapEngine(int rows, int cols, unsigned int threads, unsigned int seed)
+    : heatRows(short(rows)), heatCols(short(cols)),
+      heatThreads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      heatRng(seed ? seed : std::random_device{}()) {
+    Puzzle pz(cols, rows);
+    for (const Ship &armadaShip : pz.puzzleShips) {
+      int type = int(armadaShip.shipType) - int(cell_t::battleship);
+      if (heatArmada[type]++ > 0) {
+        continue;
+      }
+      heatFirst[type] = int(heatPlacements.size());
+      bool submarine = armadaShip.shipType == cell_t::submarine;
+      for (short r = 0; r < rows; r++) {
+        for (short c = 0; c < cols; c++) {
+          for (int v = 0; v < (submarine ? 1 : 2); v++) {
+            Ship ship = armadaShip;
+            ship.shipHeadCell = Cell(r, c);
+            if (not submarine) {
+              ship.shipOrientation = v ? Ship::orientation::V : Ship::orientation::H;
+            }
+            auto body = pz.getShipBody(ship);
+            if (int(body.size()) != ship.shipSize) {
+              continue;
+            }
+            Placement p{ type, {}, {} };
+            for (const Cell &cell : body) {
+              p.body[cell.row] |= std::uint16_t(1u << cell.col);
+            }
+            for (const Cell &cell : pz.getShipShadow(ship)) {
+              p.shadow[cell.row] |= std::uint16_t(1u << cell.col);
+            }
+            heatPlacements.push_back(p);
+          }
+        }
+      }
+    }
+    heatFirst[4] = int(heatPlacements.size());
+
+    std::size_t count = heatPlacements.size();
+    heatWords = (count + 63) / 64;
+    heatConflicts.assign(count * heatWords, 0);
+    heatCovering.assign(std::size_t(rows * cols) * heatWords, 0);
+    for (std::size_t i = 0; i < count; i++) {
+      const Placement &p = heatPlacements[i];
+      for (short r = 0; r < rows; r++) {
+        for (std::uint16_t bits = p.body[r]; bits; bits &= std::uint16_t(bits - 1)) {
+          heatCovering[std::size_t(r * cols + __builtin_ctz(bits)) * heatWords + i / 64] |= 1ull << (i % 64);
+        }
+      }
+      for (std::size_t j = 0; j < count; j++) {
+        const Placement &q = heatPlacements[j];
+        bool touches = false;
+        for (short r = 0; r < rows and not touches; r++) {
+          touches = (q.body[r] & p.shadow[r]) != 0;
+        }
+        if (touches) {
+          heatConflicts[i * heatWords + j / 64] |= 1ull << (j % 64);
+        }
+      }
+    }
+    heatKilled.assign(count, 0);
+  }
+
+/**
+ * @brief Checks whether a placement contradicts a shot.
+ *
+ * A miss cannot be in the body; a hit must be in the body or away from the placement,
+ * since the ship it belongs to cannot touch another one.
+ */
+  bool HeatmapEngine::contradicts(const Placement &p, const Shot &shot) const {
+    std::uint16_t bit = std::uint16_t(1u << shot.col);
+    bool inBody = p.body[shot.row] & bit;
+    return shot.hit ? (not inBody and (p.shadow[shot.row] & bit)) : inBody;
+  }
+
+/**
+ * @brief Records a shot; placements contradicting it are skipped from now on.
+ *
+ * @param shot The shot.
+ * @return False if the cell is outside the board or was already shot.
+ */
+  bool HeatmapEngine::shoot(const Shot &shot) {
+    if (shot.row < 0 or shot.row >= heatRows or shot.col < 0 or shot.col >= heatCols) {
+      return false;
+    }
+    for (const Shot &s : heatShots) {
+      if (s.row == shot.row and s.col == shot.col) {
+        return false;
+      }
+    }
+    heatShots.push_back(shot);
+    for (std::size_t i = 0; i < heatPlacements.size(); i++) {
+      heatKilled[i] += contradicts(heatPlacements[i], shot) ? 1 : 0;
+    }
+    if (shot.hit) {
+      heatHits[shot.row] |= std::uint16_t(1u << shot.col);
+    }
+    return true;
+  }
+
+/**
+ * @brief Adds the weight of a sample to the cells it puts a ship on.
+ */
+  void HeatmapEngine::accumulate(const Sample &s, std::vector<double> &sums) const {
+    for (short r = 0; r < heatRows; r++) {
+      for (std::uint16_t bits = s.occupied[r]; bits; bits &= std::uint16_t(bits - 1)) {
+        sums[std::size_t(r * heatCols + __builtin_ctz(bits))] += s.weight;
+      }
+    }
+  }
+
+/**
+ * @brief Finds the first hit not covered by the ships placed so far.
+ *
+ * @return False if every hit is covered.
+ */
+  bool HeatmapEngine::uncovered(const State &s, short &row, short &col) const {
+    for (short r = 0; r < heatRows; r++) {
+      std::uint16_t bits = heatHits[r] & ~s.occupied[r];
+      if (bits) {
+        row = r;
+        col = short(__builtin_ctz(bits));
+        return true;
+      }
+    }
+    return false;
+  }
+
+/**
+ * @brief Counts the placements of a set with an id in [from, to).
+ */
+  int HeatmapEngine::countRange(const Bits &bits, int from, int to) const {
+    int n = 0;
+    for (int w = from / 64; w * 64 < to; w++) {
+      std::uint64_t word = bits[std::size_t(w)];
+      if (w == from / 64) {
+        word &= ~0ull << (from % 64);
+      }
+      if ((w + 1) * 64 > to) {
+        word &= ~(~0ull << (to % 64));
+      }
+      n += __builtin_popcountll(word);
+    }
+    return n;
+  }
+
+/**
+ * @brief Removes the placements with an id in [from, to) from a set.
+ */
+  void HeatmapEngine::clearRange(Bits &bits, int from, int to) const {
+    for (int w = from / 64; w * 64 < to; w++) {
+      std::uint64_t mask = ~0ull;
+      if (w == from / 64) {
+        mask &= ~0ull << (from % 64);
+      }
+      if ((w + 1) * 64 > to) {
+        mask &= ~(~0ull << (to % 64));
+      }
+      bits[std::size_t(w)] &= ~mask;
+    }
+  }
+
+/**
+ * @brief Lists the placements that can be chosen next.
+ *
+ * While a hit is uncovered, the choices are the candidates of any remaining ship that
+ * cover the first such hit. Afterwards, they are the candidates of the first remaining
+ * type, only those after the last one chosen for that type if `ordered`.
+ *
+ * @param s The current state.
+ * @param level The candidates of the state.
+ * @param ordered Keep ships of the same type in increasing order.
+ * @param out Receives the placements.
+ */
+  void HeatmapEngine::options(const State &s, const Level &level, bool ordered, std::vector<int> &out) const {
+    out.clear();
+    short row, col;
+    if (uncovered(s, row, col)) {
+      const std::uint64_t *covering = &heatCovering[std::size_t(row * heatCols + col) * heatWords];
+      for (std::size_t w = 0; w < heatWords; w++) {
+        for (std::uint64_t bits = level.candidates[w] & covering[w]; bits; bits &= bits - 1) {
+          out.push_back(int(w * 64) + __builtin_ctzll(bits));
+        }
+      }
+      return;
+    }
+    for (int t = 0; t < 4; t++) {
+      if (s.remaining[t] > 0) {
+        int from = ordered ? std::max(heatFirst[t], s.last[t] + 1) : heatFirst[t];
+        for (int w = from / 64; w * 64 < heatFirst[t + 1]; w++) {
+          std::uint64_t bits = level.candidates[std::size_t(w)];
+          if (w == from / 64) {
+            bits &= ~0ull << (from % 64);
+          }
+          for (; bits; bits &= bits - 1) {
+            int id = w * 64 + __builtin_ctzll(bits);
+            if (id >= heatFirst[t + 1]) {
+              break;
+            }
+            out.push_back(id);
+          }
+        }
+        return;
+      }
+    }
+  }
+
+/**
+ * @brief Places a ship and keeps the candidates that neither overlap nor touch it.
+ *
+ * Placements blocking a hit they do not cover were dropped by shoot(), and since
+ * touching is symmetric, no candidate left can block a hit covered by a placed ship.
+ *
+ * @param s The current state.
+ * @param level The candidates of the state.
+ * @param id The placement.
+ * @param ordered Keep ships of the same type in increasing order once the hits are covered.
+ * @param next Receives the state with the ship placed.
+ * @param below Receives the candidates of `next`.
+ * @return False if some remaining ship has fewer candidates than ships.
+ */
+  bool HeatmapEngine::place(const State &s, const Level &level, int id, bool ordered, State &next, Level &below) const {
+    const Placement &p = heatPlacements[std::size_t(id)];
+    short row, col;
+    bool free = not uncovered(s, row, col);
+    next = s;
+    for (short r = 0; r < heatRows; r++) {
+      next.occupied[r] |= p.body[r];
+    }
+    next.remaining[p.type]--;
+    if (free) {
+      next.last[p.type] = id;
+    }
+
+    const std::uint64_t *conflicts = &heatConflicts[std::size_t(id) * heatWords];
+    below.candidates.resize(heatWords);
+    for (std::size_t w = 0; w < heatWords; w++) {
+      below.candidates[w] = level.candidates[w] & ~conflicts[w];
+    }
+    bool onlyAfter = ordered and not uncovered(next, row, col);
+    for (int t = 0; t < 4; t++) {
+      if (next.remaining[t] == 0) {
+        clearRange(below.candidates, heatFirst[t], heatFirst[t + 1]);
+        continue;
+      }
+      if (onlyAfter and next.last[t] >= 0) {
+        clearRange(below.candidates, heatFirst[t], next.last[t] + 1);
+      }
+      if (countRange(below.candidates, heatFirst[t], heatFirst[t + 1]) < next.remaining[t]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+/**
+ * @brief Counts the layouts below a state and how many of them use each placement.
+ *
+ * @param s The current state.
+ * @param levels Scratch candidates, one level per ship placed; `levels[depth]` holds those of `s`.
+ * @param depth The number of ships placed.
+ * @param perPlacement Receives, for each placement, the number of layouts using it.
+ * @param nodes Number of states visited, used to check the deadline now and then.
+ * @param deadline Stop counting at this time.
+ * @param aborted Set if the deadline passed; the counts are then incomplete.
+ * @return The number of layouts below the state.
+ */
+  std::uint64_t HeatmapEngine::count(const State &s, std::vector<Level> &levels, std::size_t depth,
+                                     std::vector<std::uint64_t> &perPlacement, unsigned long &nodes,
+                                     const std::chrono::steady_clock::time_point &deadline, bool &aborted) const {
+    short row, col;
+    if (std::all_of(s.remaining.begin(), s.remaining.end(), [](int n) { return n == 0; })) {
+      return uncovered(s, row, col) ? 0 : 1;
+    }
+    if (++nodes % deadline_check_nodes == 0 and std::chrono::steady_clock::now() >= deadline) {
+      aborted = true;
+    }
+    if (aborted) {
+      return 0;
+    }
+
+    Level &level = levels[depth];
+    options(s, level, true, level.choices);
+    std::uint64_t total = 0;
+    if (std::accumulate(s.remaining.begin(), s.remaining.end(), 0) == 1) {
+      // The last ship: each choice covering the hits left is a layout of its own.
+      for (int id : level.choices) {
+        const Placement &p = heatPlacements[std::size_t(id)];
+        bool covers = true;
+        for (short r = 0; r < heatRows and covers; r++) {
+          covers = (heatHits[r] & ~(s.occupied[r] | p.body[r])) == 0;
+        }
+        if (covers) {
+          perPlacement[std::size_t(id)]++;
+          total++;
+        }
+      }
+      return total;
+    }
+    State next;
+    for (int id : level.choices) {
+      if (aborted) {
+        break;
+      }
+      if (place(s, level, id, true, next, levels[depth + 1])) {
+        std::uint64_t below = count(next, levels, depth + 1, perPlacement, nodes, deadline, aborted);
+        perPlacement[id] += below;
+        total += below;
+      }
+    }
+    return total;
+  }
+
+/**
+ * @brief Follows one random path to a layout.
+ *
+ * Ships placed after the hits are covered may come in any order, so a layout is reached
+ * by as many paths as the orders of those ships. Its weight is the product of the number
+ * of choices along the path divided by that number of orders; the mean weight over many
+ * samples is then the number of layouts (Knuth's estimator).
+ *
+ * @param root The starting state.
+ * @param levels Scratch candidates; `levels[0]` holds those of `root`.
+ * @param rng The random generator.
+ * @param out Receives the layout and its weight.
+ * @return False if the path ended without a layout.
+ */
+  bool HeatmapEngine::sample(const State &root, std::vector<Level> &levels, std::mt19937_64 &rng, Sample &out) const {
+    std::array<int, 4> unordered{};
+    double weight = 1;
+    State s = root, next;
+    short row, col;
+    for (std::size_t depth = 0; not std::all_of(s.remaining.begin(), s.remaining.end(), [](int n) { return n == 0; }); depth++) {
+      Level &level = levels[depth];
+      bool free = not uncovered(s, row, col);
+      options(s, level, false, level.choices);
+      if (level.choices.empty()) {
+        return false;
+      }
+      int id = level.choices[std::uniform_int_distribution<std::size_t>(0, level.choices.size() - 1)(rng)];
+      weight *= double(level.choices.size());
+      if (free) {
+        weight /= ++unordered[heatPlacements[std::size_t(id)].type];
+      }
+      if (not place(s, level, id, false, next, levels[depth + 1])) {
+        return false;
+      }
+      s = next;
+    }
+    if (uncovered(s, row, col)) {
+      return false;
+    }
+    out.occupied = s.occupied;
+    out.weight = weight;
+    return true;
+  }
+
+/**
+ * @brief Computes the heatmap for the shots so far.
+ *
+ * The budget is a hard limit on the whole refresh. An exact count gets the first
+ * exact_share of it, each thread taking first choices in turn. Once there are shots it
+ * always tries, since every shot may cut the layouts by orders of magnitude; before any
+ * shot it skips the count if the last refresh estimated too many layouts. If the count
+ * does not finish, sampling takes the rest of the budget, each thread summing the weights
+ * of its samples per cell. A heatmap backed by fewer than min_samples samples is returned
+ * on time, marked unreliable. Samples are not kept across shots: those drawn before a
+ * hit was known follow other paths, and their weights made the estimate much noisier.
+ *
+ * @param budget_ms The time the whole refresh may take, in milliseconds.
+ * @return The heatmap.
+ */
+  Heatmap HeatmapEngine::refresh(double budget_ms) {
+    auto started = std::chrono::steady_clock::now();
+    auto budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budget_ms));
+    auto exactDeadline = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget * exact_share);
+    Heatmap map;
+    map.probability.assign(std::size_t(heatRows * heatCols), 0);
+
+    State root;
+    root.remaining = heatArmada;
+    Level top;
+    top.candidates.assign(heatWords, 0);
+    for (std::size_t id = 0; id < heatPlacements.size(); id++) {
+      if (heatKilled[id] == 0) {
+        top.candidates[id / 64] |= 1ull << (id % 64);
+      }
+    }
+    std::vector<int> first;
+    options(root, top, true, first);
+    const std::size_t depth = std::size_t(std::accumulate(heatArmada.begin(), heatArmada.end(), 0)) + 1;
+
+    // [1] Exact count.
+    std::vector<std::uint64_t> perPlacement(heatPlacements.size(), 0);
+    std::uint64_t total = 0;
+    std::atomic<bool> aborted{ false };
+    std::atomic<std::size_t> next{ 0 };
+    std::mutex lock;
+    auto exact = [&]() {
+      std::vector<std::uint64_t> mine(heatPlacements.size(), 0);
+      std::uint64_t sum = 0;
+      unsigned long nodes = 0;
+      bool stop = false;
+      std::vector<Level> levels(depth);
+      levels[0] = top;
+      State s;
+      for (std::size_t i = next++; i < first.size() and not aborted; i = next++) {
+        int id = first[i];
+        if (not place(root, top, id, true, s, levels[1])) {
+          continue;
+        }
+        std::uint64_t below = count(s, levels, 1, mine, nodes, exactDeadline, stop);
+        mine[id] += below;
+        sum += below;
+        if (stop) {
+          aborted = true;
+        }
+      }
+      std::lock_guard<std::mutex> guard(lock);
+      for (std::size_t i = 0; i < mine.size(); i++) {
+        perPlacement[i] += mine[i];
+      }
+      total += sum;
+    };
+    std::vector<std::thread> workers;
+    if (heatShots.empty() and heatLayouts > max_exact_layouts) {
+      aborted = true;
+    } else {
+      for (unsigned int t = 1; t < heatThreads; t++) {
+        workers.emplace_back(exact);
+      }
+      exact();
+      for (std::thread &w : workers) {
+        w.join();
+      }
+      workers.clear();
+    }
+
+    if (not aborted) {
+      for (std::size_t id = 0; id < heatPlacements.size() and total > 0; id++) {
+        for (short r = 0; r < heatRows; r++) {
+          for (std::uint16_t bits = heatPlacements[id].body[r]; bits; bits &= std::uint16_t(bits - 1)) {
+            map.probability[r * heatCols + __builtin_ctz(bits)] += double(perPlacement[id]) / double(total);
+          }
+        }
+      }
+      map.exact = true;
+      map.reliable = true;
+      map.layouts = double(total);
+      heatLayouts = map.layouts;
+      map.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+      return map;
+    }
+
+    // [2] Sampling for the rest of the budget.
+    std::size_t attempts = 0;
+    double weights = 0;
+    auto sampler = [&](std::uint64_t seed) {
+      std::mt19937_64 rng(seed);
+      std::vector<double> sums(map.probability.size(), 0);
+      std::size_t tried = 0, found = 0;
+      double sum = 0;
+      std::vector<Level> levels(depth);
+      levels[0] = top;
+      Sample s;
+      while (std::chrono::steady_clock::now() < started + budget) {
+        tried++;
+        if (sample(root, levels, rng, s)) {
+          found++;
+          sum += s.weight;
+          accumulate(s, sums);
+        }
+      }
+      std::lock_guard<std::mutex> guard(lock);
+      for (std::size_t i = 0; i < sums.size(); i++) {
+        map.probability[i] += sums[i];
+      }
+      map.samples += found;
+      attempts += tried;
+      weights += sum;
+    };
+    for (unsigned int t = 1; t < heatThreads; t++) {
+      workers.emplace_back(sampler, heatRng());
+    }
+    sampler(heatRng());
+    for (std::thread &w : workers) {
+      w.join();
+    }
+
+    for (double &p : map.probability) {
+      p = weights > 0 ? p / weights : 0;
+    }
+    map.layouts = attempts ? weights / double(attempts) : 0;
+    map.reliable = map.samples >= min_samples;
+    heatLayouts = map.layouts;
+    map.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return map;
+  }
+
+}
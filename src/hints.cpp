@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/hints.h"
+#include "include/store.h"
+
+namespace bpg{
+
+/**
+ * @brief Lists every placement of every ship of a solution's armada.
+ *
+ * The row and column counts of the solution are the constraints of every search.
+ * Placements that do not fit those counts on their own are left out.
+ *
+ * @param solution A valid layout.
+ */
+  HintSolver::HintSolver(const Puzzle &solution)
+    : solverRows(solution.puzzleRows), solverCols(solution.puzzleCols),
+      solverRowCount(solution.puzzleRows, 0), solverColCount(solution.puzzleCols, 0) {
+    Puzzle pz(solverCols, solverRows);
+    for (const Ship &ship : solution.puzzleShips) {
+      for (const Cell &cell : pz.getShipBody(ship)) {
+        solverRowCount[cell.row]++;
+        solverColCount[cell.col]++;
+      }
+    }
+
+    solverByShip.resize(pz.puzzleShips.size());
+    solverChosen.assign(pz.puzzleShips.size(), -1);
+    for (std::size_t i = 0; i < pz.puzzleShips.size(); i++) {
+      if (i > 0 and pz.puzzleShips[i].shipType == pz.puzzleShips[i - 1].shipType) {
+        solverByShip[i] = solverByShip[i - 1];
+        continue;
+      }
+      bool submarine = pz.puzzleShips[i].shipType == cell_t::submarine;
+      for (short r = 0; r < solverRows; r++) {
+        for (short c = 0; c < solverCols; c++) {
+          for (int v = 0; v < (submarine ? 1 : 2); v++) {
+            Placement p{ i, pz.puzzleShips[i], {}, {}, {}, {} };
+            p.ship.shipHeadCell = Cell(r, c);
+            if (not submarine) {
+              p.ship.shipOrientation = v ? Ship::orientation::V : Ship::orientation::H;
+            }
+            auto body = pz.getShipBody(p.ship);
+            if (int(body.size()) != p.ship.shipSize) {
+              continue;
+            }
+            std::vector<short> rowCells(solverRows, 0), colCells(solverCols, 0);
+            bool fits = true;
+            for (const Cell &cell : body) {
+              p.body[cell.row] |= std::uint16_t(1u << cell.col);
+              p.bodyT[cell.col] |= std::uint16_t(1u << cell.row);
+              fits = fits and ++rowCells[cell.row] <= solverRowCount[cell.row]
+                          and ++colCells[cell.col] <= solverColCount[cell.col];
+            }
+            if (not fits) {
+              continue;
+            }
+            for (const Cell &cell : pz.getShipShadow(p.ship)) {
+              p.shadow[cell.row] |= std::uint16_t(1u << cell.col);
+              p.shadowT[cell.col] |= std::uint16_t(1u << cell.row);
+            }
+            solverByShip[i].push_back(int(solverPlacements.size()));
+            solverPlacements.push_back(p);
+          }
+        }
+      }
+    }
+    solverKilled.assign(solverPlacements.size(), 0);
+  }
+
+/**
+ * @brief Gives the kind of hint a ship shows on one of its cells.
+ *
+ * @param ship The ship.
+ * @param cell A cell of the ship's body.
+ * @return The kind of the cell, as drawn in the matrix file.
+ */
+  hint_t HintSolver::kindOf(const Ship &ship, const Cell &cell) {
+    if (ship.shipType == cell_t::submarine) {
+      return hint_t::submarine;
+    }
+    bool vertical = ship.shipOrientation == Ship::orientation::V;
+    int offset = vertical ? cell.row - ship.shipHeadCell.row : cell.col - ship.shipHeadCell.col;
+    if (offset == 0) {
+      return vertical ? hint_t::top : hint_t::left;
+    }
+    if (offset == ship.shipSize - 1) {
+      return vertical ? hint_t::bottom : hint_t::right;
+    }
+    return hint_t::middle;
+  }
+
+/**
+ * @brief Checks whether a placement contradicts a hint.
+ *
+ * A water cell cannot be in the body; a ship cell must either be in the body with the
+ * same kind, or stay away from the placement, since ships do not touch.
+ *
+ * @param p The placement.
+ * @param hint The hint.
+ * @return True if no solution can hold both.
+ */
+  bool HintSolver::contradicts(const Placement &p, const Hint &hint) const {
+    std::uint16_t bit = std::uint16_t(1u << hint.col);
+    bool inBody = p.body[hint.row] & bit;
+    if (hint.kind == hint_t::water) {
+      return inBody;
+    }
+    if (inBody) {
+      return kindOf(p.ship, Cell(hint.row, hint.col)) != hint.kind;
+    }
+    return p.shadow[hint.row] & bit;
+  }
+
+/**
+ * @brief Adds a hint; placements contradicting it are skipped until it is removed.
+ *
+ * @param hint The hint to add.
+ */
+  void HintSolver::addHint(const Hint &hint) {
+    for (std::size_t i = 0; i < solverPlacements.size(); i++) {
+      solverKilled[i] += contradicts(solverPlacements[i], hint) ? 1 : 0;
+    }
+    if (hint.kind != hint_t::water) {
+      solverSegments[hint.row] |= std::uint16_t(1u << hint.col);
+    }
+  }
+
+/**
+ * @brief Removes a hint added before.
+ *
+ * @param hint The hint to remove.
+ */
+  void HintSolver::removeHint(const Hint &hint) {
+    for (std::size_t i = 0; i < solverPlacements.size(); i++) {
+      solverKilled[i] -= contradicts(solverPlacements[i], hint) ? 1 : 0;
+    }
+    if (hint.kind != hint_t::water) {
+      solverSegments[hint.row] &= std::uint16_t(~(1u << hint.col));
+    }
+  }
+
+/**
+ * @brief Places ship `index` and the following ones.
+ *
+ * Same-type ships take placements in increasing order, so each layout is found once.
+ * A branch is cut as soon as a row or column cannot reach its count with the cells
+ * still free, or a hinted ship cell is blocked without being covered.
+ */
+  void HintSolver::search(std::size_t index, State &s) {
+    if (index == solverByShip.size()) {
+      bool covered = true;
+      for (short r = 0; r < solverRows; r++) {
+        covered = covered and (solverSegments[r] & ~s.occupied[r]) == 0;
+      }
+      solverFound += covered ? 1 : 0;
+      return;
+    }
+
+    const std::vector<int> &candidates = solverByShip[index];
+    if (candidates.empty()) {
+      return;
+    }
+    std::size_t first = 0;
+    if (index > 0 and solverPlacements[candidates[0]].group != index) {
+      first = std::size_t(solverChosen[index - 1]) + 1;
+    }
+    const std::uint16_t fullRow = std::uint16_t((1u << solverCols) - 1);
+    const std::uint16_t fullCol = std::uint16_t((1u << solverRows) - 1);
+
+    for (std::size_t k = first; k < candidates.size() and solverFound < solverLimit; k++) {
+      if (solverKilled[candidates[k]] > 0) {
+        continue;
+      }
+      const Placement &p = solverPlacements[candidates[k]];
+      solverNodes++;
+      State next = s;
+      bool ok = true;
+      for (short r = 0; r < solverRows and ok; r++) {
+        ok = (p.body[r] & s.blocked[r]) == 0;
+        next.rowNeed[r] = short(s.rowNeed[r] - __builtin_popcount(p.body[r]));
+        next.occupied[r] = s.occupied[r] | p.body[r];
+        next.blocked[r] = s.blocked[r] | p.shadow[r];
+        ok = ok and next.rowNeed[r] >= 0
+                and __builtin_popcount(~next.blocked[r] & fullRow) >= next.rowNeed[r]
+                and (solverSegments[r] & next.blocked[r] & ~next.occupied[r]) == 0;
+      }
+      for (short c = 0; c < solverCols and ok; c++) {
+        next.colNeed[c] = short(s.colNeed[c] - __builtin_popcount(p.bodyT[c]));
+        next.blockedT[c] = s.blockedT[c] | p.shadowT[c];
+        ok = next.colNeed[c] >= 0 and __builtin_popcount(~next.blockedT[c] & fullCol) >= next.colNeed[c];
+      }
+      if (not ok) {
+        continue;
+      }
+      solverChosen[index] = int(k);
+      search(index + 1, next);
+    }
+    solverChosen[index] = -1;
+  }
+
+/**
+ * @brief Counts the layouts that agree with the counts and the current hints.
+ *
+ * @param limit Stop counting at this number of layouts; 2 is enough to check uniqueness.
+ * @return The number of layouts found, at most `limit`.
+ */
+  std::size_t HintSolver::countSolutions(std::size_t limit) {
+    State s;
+    for (short r = 0; r < solverRows; r++) {
+      s.rowNeed[r] = solverRowCount[r];
+    }
+    for (short c = 0; c < solverCols; c++) {
+      s.colNeed[c] = solverColCount[c];
+    }
+    solverLimit = limit;
+    solverFound = 0;
+    search(0, s);
+    return solverFound;
+  }
+
+  namespace {
+    /// Threads kept for every round of checks of a minimization; the caller is worker 0.
+    class HintWorkers {
+    public:
+      explicit HintWorkers(unsigned int n) {
+        for (unsigned int t = 1; t < n; t++) {
+          workers.emplace_back([this, t]() { loop(t); });
+        }
+      }
+      ~HintWorkers() {
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          stop = true;
+        }
+        wake.notify_all();
+        for (std::thread &w : workers) {
+          w.join();
+        }
+      }
+      HintWorkers(const HintWorkers&) = delete;
+      HintWorkers& operator=(const HintWorkers&) = delete;
+
+      std::size_t size() const { return workers.size() + 1; }
+
+      /// Runs task(t) for every t < count, one per worker, and waits for all of them.
+      void run(std::size_t count, const std::function<void(std::size_t)> &task) {
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          current = &task;
+          active = count;
+          pending = workers.size();
+          round++;
+        }
+        wake.notify_all();
+        if (count > 0) {
+          task(0);
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+      }
+
+    private:
+      std::vector<std::thread> workers;
+      std::mutex mutex;
+      std::condition_variable wake, done;
+      const std::function<void(std::size_t)> *current = nullptr;
+      std::size_t active = 0, pending = 0, round = 0;
+      bool stop = false;
+
+      void loop(std::size_t t) {
+        std::size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+          wake.wait(lock, [&]() { return stop or round != seen; });
+          if (stop) {
+            return;
+          }
+          seen = round;
+          if (t < active) {
+            lock.unlock();
+            (*current)(t);
+            lock.lock();
+          }
+          if (--pending == 0) {
+            done.notify_one();
+          }
+        }
+      }
+    };
+
+    /**
+     * @brief Minimizes the hints of a solution with a given set of workers.
+     *
+     * Starts from every ship cell of the solution, which is always enough, and tries to
+     * remove hints in a random order, keeping each removal that leaves the solution unique.
+     * Removals are checked in batches, one per worker, each worker with its own solver.
+     * Since fewer hints never mean fewer solutions, a removal that failed never needs to be
+     * tried again; candidates after the first success of a batch are checked again later.
+     *
+     * Water cells are then tried in a random order: one is kept when, with it, at least two
+     * of the hints kept so far can go. A last pass removes whatever became redundant, so
+     * the result is irreducible: removing any one of its hints, ship or water, allows a
+     * second solution. It is empty when the row and column counts alone fix the solution.
+     */
+    HintSet minimizeWith(const Puzzle &solution, unsigned int seed, HintWorkers &workers, unsigned long &checks) {
+      Puzzle pz(solution.puzzleCols, solution.puzzleRows);
+      HintSet all;
+      std::vector<bool> ship(std::size_t(solution.puzzleRows) * solution.puzzleCols, false);
+      for (const Ship &s : solution.puzzleShips) {
+        for (const Cell &cell : pz.getShipBody(s)) {
+          all.push_back(Hint{ cell.row, cell.col, HintSolver::kindOf(s, cell) });
+          ship[std::size_t(cell.row) * solution.puzzleCols + cell.col] = true;
+        }
+      }
+      std::size_t shipHints = all.size();
+      for (short r = 0; r < solution.puzzleRows; r++) {
+        for (short c = 0; c < solution.puzzleCols; c++) {
+          if (not ship[std::size_t(r) * solution.puzzleCols + c]) {
+            all.push_back(Hint{ r, c, hint_t::water });
+          }
+        }
+      }
+      std::vector<HintSolver> solvers(workers.size(), HintSolver(solution));
+      std::vector<bool> kept(all.size(), false);
+      auto add = [&](std::size_t i) {
+        kept[i] = true;
+        for (HintSolver &solver : solvers) {
+          solver.addHint(all[i]);
+        }
+      };
+      auto drop = [&](std::size_t i) {
+        kept[i] = false;
+        for (HintSolver &solver : solvers) {
+          solver.removeHint(all[i]);
+        }
+      };
+      std::mt19937 rng(seed);
+      checks = 0;
+
+      // Removes the hints of `queue` that can go, in that order; returns them.
+      std::vector<std::size_t> queue;
+      std::vector<char> unique(workers.size(), 0);
+      std::function<void(std::size_t)> check = [&](std::size_t t) {
+        const Hint &hint = all[queue[t]];
+        solvers[t].removeHint(hint);
+        unique[t] = solvers[t].countSolutions(2) == 1;
+        solvers[t].addHint(hint);
+      };
+      auto reduce = [&]() {
+        std::vector<std::size_t> removed;
+        while (not queue.empty()) {
+          std::size_t batch = std::min<std::size_t>(workers.size(), queue.size());
+          workers.run(batch, check);
+          checks += batch;
+
+          std::size_t t = 0;
+          while (t < batch and not unique[t]) {
+            t++;
+          }
+          if (t < batch) {
+            removed.push_back(queue[t]);
+            drop(queue[t]);
+            t++;
+          }
+          queue.erase(queue.begin(), queue.begin() + std::ptrdiff_t(t));
+        }
+        return removed;
+      };
+      auto keptHints = [&]() {
+        std::vector<std::size_t> out;
+        for (std::size_t i = 0; i < all.size(); i++) {
+          if (kept[i]) {
+            out.push_back(i);
+          }
+        }
+        std::shuffle(out.begin(), out.end(), rng);
+        return out;
+      };
+
+      for (std::size_t i = 0; i < shipHints; i++) {
+        add(i);
+      }
+      queue = keptHints();
+      reduce();
+
+      std::vector<std::size_t> water(all.size() - shipHints);
+      std::iota(water.begin(), water.end(), shipHints);
+      std::shuffle(water.begin(), water.end(), rng);
+      for (std::size_t w : water) {
+        std::vector<std::size_t> before = keptHints();
+        if (before.size() < 2) {
+          break;
+        }
+        add(w);
+        queue = before;
+        std::vector<std::size_t> removed = reduce();
+        if (removed.size() < 2) {
+          for (std::size_t i : removed) {
+            add(i);
+          }
+          drop(w);
+        }
+      }
+      queue = keptHints();
+      reduce();
+
+      HintSet hints;
+      for (std::size_t i = 0; i < all.size(); i++) {
+        if (kept[i]) {
+          hints.push_back(all[i]);
+        }
+      }
+      return hints;
+    }
+  }
+
+/**
+ * @brief Finds a small set of hints that, with the row and column counts, has a single solution.
+ *
+ * See minimizeWith(); the worker threads last for this call only.
+ *
+ * @param solution A valid layout.
+ * @param seed The seed of the removal order.
+ * @param threads The number of removals checked at the same time.
+ * @param checks Receives the number of uniqueness checks made.
+ * @return The hints kept.
+ */
+  HintSet minimizeHints(const Puzzle &solution, unsigned int seed, unsigned int threads, unsigned long &checks) {
+    HintWorkers workers(std::max(1u, threads));
+    return minimizeWith(solution, seed, workers, checks);
+  }
+
+/**
+ * @brief Minimizes the hints of every puzzle of a store.
+ *
+ * Puzzle i uses the removal order of seed + i, so a batch gives the same hints
+ * whichever way it is run. The same worker threads serve every puzzle.
+ *
+ * @param puzzles The solutions.
+ * @param seed The seed of the removal order of the first puzzle.
+ * @param threads The number of removals checked at the same time.
+ * @param checks Receives the number of uniqueness checks made.
+ * @return The hints of each puzzle, in the order of the store.
+ */
+  std::vector<HintSet> minimizeHints(const PuzzleStore &puzzles, unsigned int seed, unsigned int threads, unsigned long &checks) {
+    HintWorkers workers(std::max(1u, threads));
+    std::vector<HintSet> hints;
+    Puzzle pz(puzzles.storeCols, puzzles.storeRows);
+    checks = 0;
+    for (std::size_t i = 0; i < puzzles.size(); i++) {
+      unsigned long done = 0;
+      puzzles.materialize(i, pz);
+      hints.push_back(minimizeWith(pz, seed + unsigned(i), workers, done));
+      checks += done;
+    }
+    return hints;
+  }
+
+}
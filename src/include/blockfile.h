@@ -0,0 +1,43 @@
+#ifndef _BLOCKFILE_H_
+#define _BLOCKFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "bpg.h"
+#include "common.h"
+
+namespace bpg {
+
+/// Summary of a block-compressed write.
+struct CompressionReport {
+  std::size_t rawBytes = 0;        //!< Size of the text, as a plain output file would hold it.
+  std::size_t compressedBytes = 0; //!< Size of the file written, header and index included.
+  std::size_t blocks = 0;          //!< Number of compressed blocks.
+  double elapsed_ms = 0;           //!< Wall-clock time spent rendering, compressing and writing.
+};
+
+/// Renders the text of puzzle `index` into `out`, using `pz` as scratch.
+using PuzzleText = std::function<void(std::size_t index, Puzzle &pz, std::string &out)>;
+
+/**
+ * Block files hold the same text as the plain output files, compressed with zlib in
+ * independent blocks of block_puzzles puzzles.
+ *
+ * Layout: a header, the uncompressed preamble (the puzzle count line), the blocks and
+ * the block index. Each block starts with the offsets of its puzzles, so a reader
+ * decompresses a single block to get any puzzle.
+ *
+ * These functions exist only when the build found zlib (BPG_HAS_ZLIB is defined).
+ */
+std::string BlockFileName(const std::string &FileName);
+bool IsBlockFile(const std::string &FileName);
+CompressionReport SaveBlocks(const std::string &FileName, const std::string &preamble, std::size_t count,
+                             short rows, short cols, const PuzzleText &text);
+bool ReadBlockFile(const std::string &FileName, std::string &text);
+bool ReadBlockPuzzle(const std::string &FileName, std::size_t k, std::string &text);
+
+}
+#endif
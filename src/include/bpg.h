@@ -10,6 +10,11 @@
 
 namespace bpg {
 
+class PuzzleStore;
+struct PuzzleRecord;
+class Deduplicator;
+struct MutationReport;
+
 enum class cell_t : unsigned short {
   water = 0,
   battleship,
@@ -109,6 +114,9 @@ public:
   std::string puzzleKey;
   std::string puzzleArmada;
   Cell endLocation = { puzzleRows, 0 };
+  CellMask puzzleRequired{};   //!< Cells that some ship must cover; set with setRequired().
+  bool puzzleHasRequired = false; //!< Some cell of puzzleRequired is set.
+  CellMask puzzleForbidden{};  //!< Cells no ship may cover.
 
   /// Default constructor
   Puzzle(int c = 10, int r = 10, Ship s = {}, std::vector<std::vector<cell_t>> b = {}, std::string k = "")
@@ -137,14 +145,32 @@ public:
   std::list<Cell> getShipBody(const Ship& ship);
   bool addShip(const Ship& ship);
   bool removeShip(const Ship& ship);
+  void setRequired(const CellMask &cells);
+  /// Checks whether the required cells can still be covered; always true, at no cost, without any.
+  bool canCoverRequired(std::size_t next) { return not puzzleHasRequired or reachesRequired(next); }
+  bool reachesRequired(std::size_t next);
+};
+
+/// Summary of a generation run.
+struct GenerationReport {
+  std::size_t requested = 0;  //!< Number of puzzles asked for.
+  std::size_t found = 0;      //!< Number of distinct puzzles generated.
+  unsigned long restarts = 0; //!< Restarts of the randomized search.
+  double elapsed_ms = 0;      //!< Wall-clock time spent generating.
+  bool deadline_hit = false;  //!< True if the deadline stopped the search.
 };
 
 class Generator {
 public:
   static void generatePuzzleKey(Puzzle &pz);
-  static void generateAux(int index, Puzzle &pz, std::set<std::string> &pzKeys, const RunningOpt &opt, std::list<Puzzle> &puzzleList);
-  [[nodiscard]] static std::list<Puzzle> generate(const RunningOpt &opt);
+  static void generateAux(int index, Puzzle &pz, Deduplicator &pzKeys, const RunningOpt &opt, PuzzleStore &store);
+  [[nodiscard]] static PuzzleStore generate(const RunningOpt &opt);
+  [[nodiscard]] static PuzzleStore generateDlx(const RunningOpt &opt);
+  [[nodiscard]] static PuzzleStore generateAnytime(const RunningOpt &opt, GenerationReport &report);
+  [[nodiscard]] static PuzzleStore generateAfter(unsigned short rows, unsigned short cols, const PuzzleRecord *after, std::size_t n);
+  [[nodiscard]] static PuzzleStore generateMutate(const RunningOpt &opt, MutationReport &report);
   static void generateArmada(Puzzle &pz);
+  static bool parseArmada(Puzzle &pz);
   static Cell nextLocation(const Cell& current, Puzzle &pz);
 };
 
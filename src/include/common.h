@@ -1,6 +1,9 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 constexpr unsigned short max_rows{ 16 };
@@ -11,18 +14,58 @@ constexpr unsigned short min_cols{ 7 };
 
 constexpr unsigned short min_n_puzzles{ 1 };
 constexpr unsigned short max_n_puzzles{ 100 };
+/// Largest number of puzzles when --dedup-budget bounds the memory of the duplicate check.
+constexpr unsigned int max_n_puzzles_budgeted{ 10000000 };
 
 constexpr unsigned short default_rows{ 10 };
 constexpr unsigned short default_cols{ 10 };
 constexpr unsigned short default_n_puzzles{ 1 };
 
+constexpr unsigned int default_pool_capacity{ 1024 };
+constexpr unsigned int pool_slot_size{ 128 };
+constexpr unsigned int default_pool_low_watermark{ 256 };
+
+constexpr std::size_t zdd_max_states{ 64000000 };
+
+constexpr unsigned int block_puzzles{ 64 };
+
+constexpr unsigned int default_job_deadline_ms{ 30000 };
+
+/// Search engines available to the generator.
+enum class engine_t : unsigned char {
+  dfs = 0, //!< Lexicographic scan of head cells (Generator::generateAux).
+  dlx      //!< Exact cover with Dancing Links (DancingLinks).
+};
+
+/// A set of cells: one bit per cell (bit c is column c), one word per row.
+using CellMask = std::array<std::uint16_t, max_rows>;
+
 /// Running Options
 struct RunningOpt {
-  unsigned short n_puzzles = default_n_puzzles;
+  unsigned int n_puzzles = default_n_puzzles;
   unsigned short rows = default_rows;
   unsigned short cols = default_cols;
-  std::string armada_file{ "puzzles_armada.bp" };
-  std::string matrix_file{ "puzzles_matrix.bp" };
+  std::string armada_file{ "../output/puzzles_armada.bp" };
+  std::string matrix_file{ "../output/puzzles_matrix.bp" };
+  std::string pool_file{};   //!< Serve puzzles from this pool file instead of generating them.
+  bool pool_fill = false;    //!< Pre-generate every dimension of the pool file and quit.
+  std::string validate_file{}; //!< Validate the puzzles of this armada file and quit.
+  unsigned int deadline_ms = 0;  //!< When not zero, stop generating after this many milliseconds.
+  std::string jobs_file{};       //!< Run every job of this manifest file and quit.
+  engine_t engine = engine_t::dfs; //!< Search engine used by Generator::generate.
+  std::string zdd_prefix{};      //!< Serve puzzles from the layout ZDD stored as `<prefix>_<rows>x<cols>.zdd`.
+  std::string zdd_index{};       //!< With zdd_prefix, the number of the first puzzle (decimal); empty to sample.
+  bool zdd_build = false;        //!< Build the ZDD of every dimension and quit.
+  unsigned int seed = 0;         //!< Seed of the randomized search; zero picks a random seed.
+  std::size_t dedup_budget_kb = 0; //!< Memory budget of the duplicate check in KB; zero for no limit.
+  bool compress = false;         //!< Write block-compressed output files (`.bpz`) instead of plain ones.
+  std::size_t extract = 0;       //!< With validate_file, check and print only this puzzle (starting at 1).
+  bool hints = false;            //!< Add to each puzzle a minimal set of revealed cells making it unique.
+  std::string heatmap_file{};    //!< Replay the shots of this file and print the ship probability heatmap.
+  std::string constraints_file{}; //!< Cells every generated puzzle must cover or leave as water.
+  CellMask required{};           //!< Cells a ship must cover, read from constraints_file.
+  CellMask forbidden{};          //!< Cells that must stay water, read from constraints_file.
+  unsigned int mutate_moves = 0; //!< When not zero, walk Markov chains and sample a puzzle every this many moves.
 };
 
 #endif  // !COMMON_H
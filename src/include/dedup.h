@@ -0,0 +1,78 @@
+#ifndef _DEDUP_H_
+#define _DEDUP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace bpg {
+
+/**
+ * A Deduplicator remembers which puzzles were already generated, within a memory budget.
+ *
+ * Without a budget it is a plain in-memory hash set of (12-byte) records. With a budget,
+ * a blocked Bloom filter answers most "never seen" queries without touching the table;
+ * the exact table holds recent records and, when it fills up, is sorted and spilled to
+ * disk as a run. Runs are memory-mapped, searched through a sparse in-memory index and
+ * merged when there are too many of them. The filter, the table, the indexes of the runs
+ * and the merge buffer together stay within the budget. Answers are always exact.
+ */
+class Deduplicator {
+public:
+  //=== Special members
+  /// Creates an empty set; `budgetBytes` zero means no memory limit.
+  explicit Deduplicator(std::size_t budgetBytes = 0);
+  /// Destructor. Unmaps the runs; their files are already unlinked.
+  ~Deduplicator();
+  Deduplicator(const Deduplicator&) = delete;
+  Deduplicator& operator=(const Deduplicator&) = delete;
+
+  //=== Regular methods
+  bool insert(const PuzzleRecord &rec);
+  std::size_t size() const { return dedupSize; }
+  std::size_t spills() const { return dedupSpills; }
+  std::size_t runs() const { return dedupRuns.size(); }
+
+private:
+  /// A sorted run of records spilled to disk.
+  struct Run {
+    int fd = -1;
+    const PuzzleRecord *records = nullptr;
+    std::size_t count = 0;
+    std::size_t stride = 0;            //!< Records per fence key.
+    std::vector<PuzzleRecord> fence;   //!< Every stride-th record, kept in memory.
+  };
+
+  std::size_t dedupBudget;
+  std::size_t dedupSize = 0;
+  std::size_t dedupSpills = 0;
+  std::vector<std::uint64_t> dedupBloom;     //!< Blocks of 512 bits.
+  std::vector<PuzzleRecord> dedupTable;      //!< Open addressing; `vertical == 0xFFFF` marks a free slot.
+  std::size_t dedupUsed = 0;                 //!< Records in the table.
+  std::size_t dedupLimit = 0;                //!< Records the table may hold before spilling (or growing).
+  std::vector<Run> dedupRuns;
+  std::size_t dedupBuffer = 0;               //!< Records of the merge buffer.
+
+  static std::uint64_t hash(const PuzzleRecord &rec);
+  bool bloomTest(std::uint64_t h) const;
+  void bloomAdd(std::uint64_t h);
+  bool tableInsert(const PuzzleRecord &rec, std::uint64_t h);
+  bool tableContains(const PuzzleRecord &rec, std::uint64_t h) const;
+  bool runContains(const Run &run, const PuzzleRecord &rec) const;
+  void resizeBloom(std::size_t records);
+  void resizeTable(std::size_t slots);
+  void fitTable();
+  std::size_t fenceBytes() const;
+  void spill();
+  void mergeRuns();
+  Run createRun(std::size_t stride);
+  void appendRun(Run &run, const PuzzleRecord *records, std::size_t count);
+  void finishRun(Run &run);
+};
+
+}
+#endif
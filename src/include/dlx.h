@@ -0,0 +1,68 @@
+#ifndef _DLX_H_
+#define _DLX_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "dedup.h"
+#include "store.h"
+
+namespace bpg {
+
+/**
+ * DancingLinks solves armada placement as an exact-cover problem (Knuth's Algorithm X).
+ *
+ * Each ship of the armada is a primary column and each board cell is a secondary
+ * column. A row is one placement of one ship and holds the ship column plus the cells
+ * of its body. Choosing a row also covers the cells of its shadow, which removes every
+ * placement that would overlap or touch the ship. The ship with the fewest placements
+ * left is always tried first.
+ */
+class DancingLinks {
+public:
+  //=== Special members
+  /// Builds the matrix of every placement of every ship for a board of the given dimension.
+  DancingLinks(int r = default_rows, int c = default_cols, const CellMask &forbidden = {});
+
+  //=== Regular methods
+  void solve(std::size_t limit, Deduplicator &pzKeys, PuzzleStore &store);
+
+private:
+  /// A node of the four-way linked matrix. Column headers are nodes too.
+  struct Node {
+    int left, right, up, down;
+    int column; //!< Header of the node's column.
+    int row;    //!< Placement the node belongs to, -1 for headers.
+  };
+  /// A candidate placement of a ship.
+  struct Placement {
+    int ship;                 //!< Index of the ship in the armada.
+    Ship placement;           //!< Ship with its head cell and orientation.
+    int head;                 //!< Row-major index of the head cell.
+    std::vector<int> shadow;  //!< Cell columns covered by the ship's shadow.
+  };
+
+  short dlxRows;
+  short dlxCols;
+  std::vector<Node> dlxNodes;
+  std::vector<int> dlxSize;          //!< Rows left in each column.
+  std::vector<bool> dlxCovered;      //!< Cell columns currently covered by some shadow.
+  std::vector<Placement> dlxPlacements;
+  std::vector<int> dlxChosen;        //!< Placement chosen for each ship, -1 if none.
+  std::vector<int> dlxGroup;         //!< First ship of the same type, for symmetry breaking.
+  std::size_t dlxLimit = 0;
+  bool dlxDone = false;
+
+  int root() const { return 0; }
+  int shipColumn(int ship) const { return 1 + ship; }
+  int cellColumn(int r, int c) const { return 1 + int(armada_size) + r * dlxCols + c; }
+  void cover(int column);
+  void uncover(int column);
+  bool allowed(const Placement &p) const;
+  void search(Puzzle &pz, Deduplicator &pzKeys, PuzzleStore &store);
+};
+
+}
+#endif
@@ -0,0 +1,111 @@
+#ifndef _HEATMAP_H_
+#define _HEATMAP_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+
+namespace bpg {
+
+/// A shot of the player and what it found.
+struct Shot {
+  short row = 0;
+  short col = 0;
+  bool hit = false;
+};
+
+/// Probability of each cell holding a ship, row-major.
+struct Heatmap {
+  std::vector<double> probability;
+  bool exact = false;        //!< True if every consistent layout was counted.
+  double layouts = 0;        //!< Number of consistent layouts (an estimate when sampled).
+  std::size_t samples = 0;   //!< Samples behind the estimate; zero when exact.
+  bool reliable = false;     //!< False when too few samples back the estimate.
+  double elapsed_ms = 0;     //!< Time spent by refresh().
+};
+
+/**
+ * A HeatmapEngine finds, for each cell, the share of armada layouts consistent with the
+ * shots so far that put a ship on it.
+ *
+ * Placements follow Puzzle::getShipBody and Puzzle::getShipShadow. Each one keeps a
+ * bitset of the placements it overlaps or touches, so placing a ship narrows the
+ * candidates of the next ones with a few word operations. Ships covering hits are placed
+ * first, one uncovered hit at a time, and the other ships afterwards. When counting, those
+ * other ships come in increasing order per type, so every layout is reached by a single
+ * path. refresh() counts all of them when it can within its budget, splitting the first
+ * choices among threads; otherwise it estimates the heatmap by sampling random paths
+ * weighted by the number of choices along them (Knuth's estimator).
+ */
+class HeatmapEngine {
+public:
+  //=== Special members
+  HeatmapEngine(int rows, int cols, unsigned int threads = 0, unsigned int seed = 0);
+
+  //=== Regular methods
+  bool shoot(const Shot &shot);
+  Heatmap refresh(double budget_ms = 50);
+  const std::vector<Shot>& shots() const { return heatShots; }
+
+private:
+  using Rows = std::array<std::uint16_t, max_rows>;   //!< One bit per cell, one word per row.
+  using Bits = std::vector<std::uint64_t>;            //!< One bit per placement.
+
+  struct Placement {
+    int type;   //!< 0 battleship, 1 destroyer, 2 cruiser, 3 submarine.
+    Rows body{}, shadow{};
+  };
+
+  /// Placements still possible, and the choices being tried.
+  struct Level {
+    Bits candidates;
+    std::vector<int> choices;
+  };
+
+  struct State {
+    Rows occupied{};
+    std::array<int, 4> remaining{};
+    std::array<int, 4> last{ { -1, -1, -1, -1 } };   //!< Last placement of each type after the hits.
+  };
+
+  /// A sampled layout and its weight.
+  struct Sample {
+    Rows occupied;
+    double weight;
+  };
+
+  short heatRows, heatCols;
+  unsigned int heatThreads;
+  std::mt19937_64 heatRng;
+  std::vector<Placement> heatPlacements;   //!< Grouped by type.
+  std::array<int, 5> heatFirst{};          //!< Placements of type t are [heatFirst[t], heatFirst[t + 1]).
+  std::size_t heatWords = 0;               //!< Words of a Bits.
+  Bits heatConflicts;                      //!< Per placement, those it overlaps or touches (itself included).
+  Bits heatCovering;                       //!< Per cell, the placements covering it.
+  std::vector<int> heatKilled;             //!< Shots contradicted by each placement.
+  Rows heatHits{};
+  std::vector<Shot> heatShots;
+  double heatLayouts = 0;                  //!< Layouts found by the last refresh, zero before the first.
+  std::array<int, 4> heatArmada{};
+
+  bool contradicts(const Placement &p, const Shot &shot) const;
+  void accumulate(const Sample &s, std::vector<double> &sums) const;
+  bool uncovered(const State &s, short &row, short &col) const;
+  int countRange(const Bits &bits, int from, int to) const;
+  void clearRange(Bits &bits, int from, int to) const;
+  void options(const State &s, const Level &level, bool ordered, std::vector<int> &out) const;
+  bool place(const State &s, const Level &level, int id, bool ordered, State &next, Level &below) const;
+  std::uint64_t count(const State &s, std::vector<Level> &levels, std::size_t depth,
+                      std::vector<std::uint64_t> &perPlacement, unsigned long &nodes,
+                      const std::chrono::steady_clock::time_point &deadline, bool &aborted) const;
+  bool sample(const State &root, std::vector<Level> &levels, std::mt19937_64 &rng, Sample &out) const;
+};
+
+}
+#endif
@@ -0,0 +1,90 @@
+#ifndef _HINTS_H_
+#define _HINTS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace bpg {
+
+/// Kinds of revealed cells; the value is the letter used in the armada file.
+enum class hint_t : char {
+  water = '~',
+  submarine = 'o',
+  left = '<',
+  right = '>',
+  top = '^',
+  bottom = 'v',
+  middle = '#'
+};
+
+/// A revealed cell of a puzzle.
+struct Hint {
+  short row = 0;
+  short col = 0;
+  hint_t kind = hint_t::water;
+};
+
+using HintSet = std::vector<Hint>;
+
+/**
+ * A HintSolver counts the layouts that agree with the row and column counts of a
+ * solution and with a set of hints.
+ *
+ * Every placement of every ship is listed once, with bitboards of its body and shadow.
+ * Each placement keeps the number of hints it contradicts, so adding or removing a hint
+ * only updates those counters; searches skip the placements with a non-zero count.
+ */
+class HintSolver {
+public:
+  //=== Special members
+  explicit HintSolver(const Puzzle &solution);
+
+  //=== Regular methods
+  void addHint(const Hint &hint);
+  void removeHint(const Hint &hint);
+  std::size_t countSolutions(std::size_t limit = 2);
+  unsigned long nodes() const { return solverNodes; }
+
+  static hint_t kindOf(const Ship &ship, const Cell &cell);
+
+private:
+  using Rows = std::array<std::uint16_t, max_rows>;   //!< One bit per cell, one word per row.
+
+  struct Placement {
+    std::size_t group;   //!< Index of the first ship of its type in the armada.
+    Ship ship;
+    Rows body{}, shadow{};     //!< Shadow includes the body.
+    Rows bodyT{}, shadowT{};   //!< Same, one word per column.
+  };
+
+  struct State {
+    Rows occupied{}, blocked{}, blockedT{};
+    std::array<short, max_rows> rowNeed{};
+    std::array<short, max_cols> colNeed{};
+  };
+
+  short solverRows, solverCols;
+  std::vector<Cell::coord_type> solverRowCount, solverColCount;
+  std::vector<std::vector<int>> solverByShip;   //!< Placements of each ship of the armada.
+  std::vector<Placement> solverPlacements;
+  std::vector<int> solverKilled;                 //!< Hints contradicted by each placement.
+  std::vector<int> solverChosen;
+  Rows solverSegments{};                          //!< Cells hinted as part of a ship.
+  std::size_t solverLimit = 0, solverFound = 0;
+  unsigned long solverNodes = 0;
+
+  bool contradicts(const Placement &p, const Hint &hint) const;
+  void search(std::size_t index, State &s);
+};
+
+HintSet minimizeHints(const Puzzle &solution, unsigned int seed, unsigned int threads, unsigned long &checks);
+std::vector<HintSet> minimizeHints(const PuzzleStore &puzzles, unsigned int seed, unsigned int threads, unsigned long &checks);
+
+}
+#endif
@@ -0,0 +1,27 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <string>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+
+namespace bpg {
+
+/// A line of a jobs manifest: one batch of puzzles of a single dimension.
+struct Job {
+  RunningOpt opt;          //!< Dimension, number of puzzles, seed and output files.
+  std::string output;      //!< Output name given in the manifest.
+  std::size_t line = 0;    //!< Line of the manifest, for messages.
+  std::size_t found = 0;   //!< Number of puzzles written.
+  double elapsed_ms = 0;   //!< Time spent on the job, output included.
+};
+
+std::vector<Job> ReadManifest(const std::string &FileName);
+double EstimatedCost(const RunningOpt &opt);
+void RunJobs(std::vector<Job> &jobs, unsigned int threads = 0);
+void PrintJobSummary(const std::vector<Job> &jobs);
+
+}
+#endif
@@ -0,0 +1,14 @@
+#ifndef _MEMSTATS_H_
+#define _MEMSTATS_H_
+
+#include <cstddef>
+
+namespace bpg {
+
+/// Number of heap allocations made through operator new since the program started.
+std::size_t allocationCount();
+/// Peak resident set size of the process, in kilobytes.
+long peakRssKb();
+
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef _MUTATE_H_
+#define _MUTATE_H_
+
+#include <array>
+#include <cstddef>
+#include <random>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace bpg {
+
+/// Local moves of a MarkovChain.
+enum class move_t : unsigned char {
+  relocate = 0, //!< Move one ship to any head cell and orientation.
+  rotate,       //!< Turn one ship by 90 degrees around one of its cells.
+  swap          //!< Exchange the places of two ships of different sizes.
+};
+
+/// Summary of a run of Generator::generateMutate.
+struct MutationReport {
+  std::size_t requested = 0;               //!< Number of puzzles asked for.
+  std::size_t found = 0;                   //!< Number of distinct puzzles emitted.
+  unsigned int chains = 0;                 //!< Independent chains, each sampling on its own thread.
+  unsigned int stalled = 0;                //!< Chains that gave up without a new puzzle for too long.
+  unsigned long moves = 0;                 //!< Moves proposed by all chains.
+  std::array<unsigned long, 3> proposed{}; //!< Moves proposed, per move_t.
+  std::array<unsigned long, 3> accepted{}; //!< Moves that left a valid layout, per move_t.
+  double overlap = 0;         //!< Mean share of ship cells two consecutive samples of a chain have in common.
+  double autocorrelation = 0; //!< Lag-1 autocorrelation of the battleship row between samples.
+  double rhat = 0;            //!< Gelman-Rubin statistic of the battleship row across chains.
+  double elapsed_ms = 0;      //!< Wall-clock time spent generating.
+  bool deadline_hit = false;  //!< True if the deadline stopped the chains.
+};
+
+/**
+ * A MarkovChain walks over the armada layouts of a board, one local move at a time.
+ *
+ * A move takes the ships it changes off the board with Puzzle::removeShip and puts
+ * their new places with Puzzle::addShip, which only checks the shadows of those ships;
+ * if a new place is refused, the old ones are restored. Every move is its own inverse
+ * and is proposed with the same probability both ways, so in the long run each valid
+ * layout is visited equally often.
+ */
+class MarkovChain {
+public:
+  //=== Special members
+  MarkovChain(const RunningOpt &opt, const PuzzleRecord &start, unsigned int seed);
+
+  //=== Regular methods
+  bool step();
+  const Puzzle& puzzle() const { return chainPz; }
+  CellMask occupied() const;
+  const std::array<unsigned long, 3>& proposed() const { return chainProposed; }
+  const std::array<unsigned long, 3>& accepted() const { return chainAccepted; }
+
+private:
+  Puzzle chainPz;
+  std::mt19937 chainRng;
+  std::array<unsigned long, 3> chainProposed{};
+  std::array<unsigned long, 3> chainAccepted{};
+
+  bool apply(const std::array<std::size_t, 2> &index, const std::array<Ship, 2> &moved, std::size_t count);
+  bool relocate(std::size_t i);
+  bool rotate(std::size_t i);
+  bool swap(std::size_t i, std::size_t j);
+};
+
+}
+#endif
@@ -0,0 +1,87 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace bpg {
+
+/// Per-dimension entry of the pool index. Both counters only ever grow.
+struct PoolIndexEntry {
+  std::uint64_t produced{0}; //!< How many puzzles were ever written to this dimension.
+  std::uint64_t consumed{0}; //!< How many puzzles were ever handed out from this dimension.
+  PuzzleRecord last{};       //!< Last puzzle written, where the next refill resumes the search.
+  std::uint16_t exhausted{0}; //!< Non-zero once every puzzle of the dimension was written.
+};
+
+/// Fixed header stored at the beginning of a pool file.
+struct PoolHeader {
+  char magic[8];              //!< File signature, "BPGPOOL".
+  std::uint32_t version;      //!< Layout version.
+  std::uint32_t slotSize;     //!< Bytes reserved for each armada record.
+  std::uint32_t capacity;     //!< Slots available for each (rows, cols) pair.
+  std::uint32_t reserved;     //!< Padding, always zero.
+  PoolIndexEntry index[max_rows - min_rows + 1][max_cols - min_cols + 1]; //!< Cursors by (rows, cols).
+};
+
+/**
+ * A PuzzlePool keeps pre-generated puzzles of every dimension in a memory-mapped file.
+ *
+ * Each (rows, cols) pair owns a ring of fixed-size slots holding armada strings, as
+ * produced by Generator::generateArmada. The produced/consumed cursors live in the file,
+ * so a puzzle is never handed out twice, not even across restarts. Refills resume the
+ * search of Generator::generateAfter from the last puzzle written, so each one costs
+ * only the puzzles it adds, however many were handed out before.
+ */
+class PuzzlePool {
+public:
+  //=== Special members
+  /// Opens (or creates) the pool file.
+  explicit PuzzlePool(const std::string &fileName, std::uint32_t capacity = default_pool_capacity);
+  /// Destructor. Stops the refill thread and unmaps the file.
+  ~PuzzlePool();
+  PuzzlePool(const PuzzlePool&) = delete;
+  PuzzlePool& operator=(const PuzzlePool&) = delete;
+
+  //=== Regular methods
+  PuzzleStore take(unsigned short rows, unsigned short cols, std::size_t n);
+  std::size_t available(unsigned short rows, unsigned short cols);
+  std::size_t refill(unsigned short rows, unsigned short cols);
+  void fillAll();
+  void startRefill(std::uint32_t lowWatermark);
+  void stopRefill();
+
+private:
+  int poolFd{-1};
+  std::size_t poolBytes{0};
+  PoolHeader *poolHeader{nullptr};
+  char *poolSlots{nullptr};
+  std::mutex poolMutex;
+
+  std::thread refillThread;
+  std::condition_variable refillCv;
+  std::mutex refillWaitMutex;             //!< Guards the wakeups of refillCv.
+  std::mutex refillMutex;                 //!< Serializes refills within the process.
+  std::atomic<bool> refillStop{false};
+  std::atomic<bool> refillPending{false}; //!< take() left some dimension low.
+  std::uint32_t refillLow{0};
+
+  PoolIndexEntry& entry(unsigned short rows, unsigned short cols);
+  char* slot(unsigned short rows, unsigned short cols, std::uint64_t position);
+  void syncSlots(unsigned short rows, unsigned short cols, std::uint64_t first, std::size_t count);
+  void wakeRefill(std::atomic<bool> &flag);
+  void lockFile(bool exclusive);
+  void unlockFile();
+  void refillLoop();
+};
+
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef _STORE_H_
+#define _STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+
+namespace bpg {
+
+/// Number of ships in an armada.
+constexpr std::size_t armada_size{ 10 };
+
+/**
+ * A PuzzleRecord is the compact form of a generated puzzle (12 bytes).
+ *
+ * Ships follow the fixed armada order used by Puzzle (B, D, D, C, C, C, S, S, S, S).
+ * Each head cell is packed in a byte as `row << 4 | col`, and bit `i` of
+ * `vertical` is set when ship `i` is placed vertically.
+ */
+struct PuzzleRecord {
+  std::uint8_t heads[armada_size]{}; //!< Packed head cell of each ship.
+  std::uint16_t vertical{0};         //!< One orientation bit per ship.
+
+  //=== Regular methods
+  static PuzzleRecord fromPuzzle(const Puzzle &pz);
+  void toPuzzle(Puzzle &pz) const;
+  PuzzleRecord canonical() const;
+
+  /// Lexicographic order, so records can be kept in ordered containers.
+  bool operator<(const PuzzleRecord &rhs) const;
+  bool operator==(const PuzzleRecord &rhs) const;
+};
+
+/**
+ * A PuzzleStore keeps the puzzles of a batch as a contiguous arena of PuzzleRecords.
+ *
+ * Boards, keys and armada strings are not stored; they are produced on demand by
+ * materialize(), usually only when the puzzles are written to the output files.
+ */
+class PuzzleStore {
+public:
+  short storeRows = default_rows; //!< Rows of every puzzle in the store.
+  short storeCols = default_cols; //!< Columns of every puzzle in the store.
+
+  //=== Special members
+  /// Default constructor. Reserves room for `capacity` puzzles up front.
+  PuzzleStore(int r = default_rows, int c = default_cols, std::size_t capacity = 0)
+    : storeRows(r), storeCols(c) {
+    storeRecords.reserve(capacity);
+  }
+
+  //=== Regular methods
+  std::size_t size() const { return storeRecords.size(); }
+  bool empty() const { return storeRecords.empty(); }
+  const PuzzleRecord& operator[](std::size_t i) const { return storeRecords[i]; }
+  std::vector<PuzzleRecord>::const_iterator begin() const { return storeRecords.cbegin(); }
+  std::vector<PuzzleRecord>::const_iterator end() const { return storeRecords.cend(); }
+
+  void push(const PuzzleRecord &rec) { storeRecords.push_back(rec); }
+  void push(const Puzzle &pz) { storeRecords.push_back(PuzzleRecord::fromPuzzle(pz)); }
+  void materialize(std::size_t i, Puzzle &pz) const;
+
+private:
+  std::vector<PuzzleRecord> storeRecords;
+};
+
+}
+#endif
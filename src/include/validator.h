@@ -0,0 +1,85 @@
+#ifndef _VALIDATOR_H_
+#define _VALIDATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace bpg {
+
+/// Reasons why a layout is not a valid puzzle.
+enum class layout_error : unsigned char {
+  none = 0,      //!< The layout is valid.
+  out_of_bounds, //!< A ship does not fit inside the board.
+  overlap,       //!< Two ships share a cell.
+  touching,      //!< A ship lies in the shadow (margin) of another ship.
+  bad_armada     //!< The armada does not have the expected ships, or could not be read.
+};
+
+/// Ways of checking a layout, from the reference path to the fastest one.
+enum class validator_path : unsigned char {
+  scalar = 0, //!< Ship by ship with Puzzle::addShip.
+  bitboard,   //!< Portable 64-bit bitboards.
+  avx2        //!< 256-bit bitboards with AVX2 (falls back to bitboard if unsupported).
+};
+
+/// Short description of a layout error.
+std::string errorToString(layout_error error);
+
+/// A layout read from some armada source, waiting to be validated.
+struct ArmadaLayout {
+  short rows = default_rows;                  //!< Rows of the puzzle board.
+  short cols = default_cols;                  //!< Columns of the puzzle board.
+  PuzzleRecord record;                        //!< Ships, in the armada order.
+  layout_error error{layout_error::none};     //!< Reading or validation result.
+};
+
+/// A 16x16 board with one bit per cell; row `r` is stored in `rows[r]`.
+struct alignas(32) BoardMask {
+  std::uint16_t rows[max_rows]{};
+};
+
+/**
+ * A BatchValidator checks many layouts of one dimension against the placement rules.
+ *
+ * Body and shadow masks of every possible ship placement are built once from
+ * Puzzle::getShipBody and Puzzle::getShipShadow. Layouts are then checked one after
+ * the other, each with a few AND/OR operations on its 256-bit board, held in a single
+ * register when the CPU supports AVX2.
+ */
+class BatchValidator {
+public:
+  short validatorRows = default_rows; //!< Rows of the boards being validated.
+  short validatorCols = default_cols; //!< Columns of the boards being validated.
+
+  //=== Special members
+  /// Builds the placement masks for the given dimension.
+  BatchValidator(int r = default_rows, int c = default_cols);
+
+  //=== Regular methods
+  static bool hasAvx2();
+  void validate(std::vector<ArmadaLayout> &layouts, validator_path path = validator_path::avx2) const;
+
+private:
+  /// Masks of a ship placement, indexed by [type][orientation][row][col].
+  struct Placement {
+    BoardMask body;
+    BoardMask shadow;
+    bool inside = false;
+  };
+  std::vector<Placement> validatorPlacements;
+
+  const Placement& placement(cell_t type, bool vertical, int row, int col) const;
+  layout_error checkBitboard(const PuzzleRecord &rec) const;
+  layout_error checkAvx2(const PuzzleRecord &rec) const;
+  void validateScalar(std::vector<ArmadaLayout> &layouts) const;
+};
+
+void validateLayouts(std::vector<ArmadaLayout> &layouts, validator_path path = validator_path::avx2);
+
+}
+#endif
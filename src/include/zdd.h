@@ -0,0 +1,81 @@
+#ifndef _ZDD_H_
+#define _ZDD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+
+namespace bpg {
+
+/// Number of layouts in a family; may exceed 64 bits on large boards.
+__extension__ typedef unsigned __int128 zdd_count;
+
+/// Decimal representation of a count.
+std::string countToString(zdd_count value);
+
+/// A ZDD node as stored in memory and on disk (32 bytes).
+struct ZddNode {
+  std::uint32_t var;       //!< Placement variable: head cell * 7 + placement option.
+  std::uint32_t lo;        //!< Child for sets without `var`.
+  std::uint32_t hi;        //!< Child for sets with `var`.
+  std::uint32_t reserved;  //!< Padding, always zero.
+  std::uint64_t countLo;   //!< Low 64 bits of the number of sets below this node.
+  std::uint64_t countHi;   //!< High 64 bits of the number of sets below this node.
+
+  zdd_count count() const { return (zdd_count(countHi) << 64) | countLo; }
+};
+
+/**
+ * A LayoutZdd is a zero-suppressed decision diagram of every valid layout of a dimension.
+ *
+ * Each variable is one placement of a ship (a head cell and one of the options B-H, B-V,
+ * D-H, D-V, C-H, C-V, S), and each layout is the set of its ten placements. Every node
+ * keeps the number of layouts below it, so layouts can be counted, numbered (rank),
+ * fetched by number (unrank) and sampled uniformly in O(depth).
+ *
+ * The diagram is built once and saved; open() maps the file read-only afterwards.
+ * Boards wider than they are tall keep the diagram of their transpose.
+ */
+class LayoutZdd {
+public:
+  short zddRows = default_rows; //!< Rows of the layouts.
+  short zddCols = default_cols; //!< Columns of the layouts.
+
+  //=== Special members
+  LayoutZdd() = default;
+  ~LayoutZdd();
+  LayoutZdd(const LayoutZdd&) = delete;
+  LayoutZdd& operator=(const LayoutZdd&) = delete;
+
+  //=== Regular methods
+  static bool supported(int r, int c);
+  bool build(int r, int c, std::size_t maxStates = zdd_max_states);
+  bool save(const std::string &fileName) const;
+  bool open(const std::string &fileName, int r, int c);
+
+  zdd_count count() const;
+  std::size_t nodeCount() const { return zddSize; }
+  PuzzleRecord unrank(zdd_count k) const;
+  bool rank(const PuzzleRecord &rec, zdd_count &k) const;
+  PuzzleRecord sample(std::mt19937_64 &rng) const;
+
+private:
+  std::vector<ZddNode> zddOwned;        //!< Nodes of a freshly built diagram.
+  const ZddNode *zddNodes = nullptr;    //!< Nodes in use (owned or mapped).
+  std::size_t zddSize = 0;
+  std::uint32_t zddRoot = 0;
+  bool zddTransposed = false;            //!< Nodes describe the board with rows and columns swapped.
+  void *zddMap = nullptr;
+  std::size_t zddMapBytes = 0;
+
+  void release();
+};
+
+}
+#endif
@@ -0,0 +1,244 @@
+#include <iostream> // std::cout, std::endl
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "include/blockfile.h"
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/file.h"
+#include "include/hints.h"
+#include "include/jobs.h"
+#include "include/store.h"
+
+namespace bpg{
+    namespace {
+        /// Microseconds per puzzle of a 100-puzzle batch by [rows - 7][cols - 7]: regular search plus
+        /// both output files, fastest of three runs of a release build on one core.
+        constexpr float job_cost_us[max_rows - min_rows + 1][max_cols - min_cols + 1] = {
+            { 4819, 149, 35, 28, 28, 30, 35, 35, 36, 40 },
+            {  179,  38, 28, 29, 31, 36, 54, 48, 44, 48 },
+            {   37,  33, 43, 48, 43, 40, 41, 46, 56, 57 },
+            {   29,  32, 33, 38, 56, 66, 61, 57, 59, 68 },
+            {   29,  33, 37, 53, 43, 48, 53, 59, 63, 72 },
+            {   31,  36, 38, 46, 48, 55, 60, 73, 75, 85 },
+            {   32,  36, 40, 51, 54, 59, 71, 79, 93, 132 },
+            {   49,  59, 71, 86, 86, 99, 108, 127, 131, 151 },
+            {   54,  61, 67, 84, 68, 78, 89, 124, 160, 186 },
+            {   66,  66, 76, 87, 97, 132, 136, 127, 122, 148 }
+        };
+    }
+
+    /*!
+    * Reads a jobs manifest.
+    *
+    * Each non-empty line not starting with '#' holds `rows cols count seed output`.
+    * A job writes `<output>_armada.bp` and `<output>_matrix.bp`. Seed 0 uses the regular
+    * (lexicographic) generator; any other seed uses the randomized search with that seed.
+    *
+    * @param FileName The name of the manifest file.
+    * @return The jobs, in the order of the manifest.
+    * @throw std::invalid_argument if the file cannot be read, a line is invalid or two
+    *        lines name the same output.
+    */
+    std::vector<Job> ReadManifest(const std::string &FileName) {
+        std::ifstream arquivo(FileName.c_str());
+        if (!arquivo.is_open()) {
+            throw std::invalid_argument("Error trying to open file: " + FileName);
+        }
+
+        std::vector<Job> jobs;
+        std::map<std::string, size_t> outputs;   // Output path and the line that names it.
+        std::string line;
+        size_t lineCount = 0;
+        while (std::getline(arquivo, line)) {
+            lineCount++;
+            std::stringstream ss(line);
+            std::string first;
+            if (!(ss >> first) || first[0] == '#') {
+                continue;
+            }
+            Job job;
+            job.line = lineCount;
+            int rows, cols, count;
+            unsigned int seed;
+            std::stringstream fields(line);
+            if (!(fields >> rows >> cols >> count >> seed >> job.output)) {
+                throw std::invalid_argument("Syntax error in " + FileName + ":" + std::to_string(lineCount));
+            }
+            if (rows < min_rows || rows > max_rows) {
+                throw std::invalid_argument("Invalid number of rows in " + FileName + ":" + std::to_string(lineCount));
+            }
+            if (cols < min_cols || cols > max_cols) {
+                throw std::invalid_argument("Invalid number of columns in " + FileName + ":" + std::to_string(lineCount));
+            }
+            if (count < min_n_puzzles || count > max_n_puzzles) {
+                throw std::invalid_argument("Invalid number of puzzles in " + FileName + ":" + std::to_string(lineCount));
+            }
+            // Jobs run concurrently, so two jobs with the same output would write the same files.
+            std::string path = std::filesystem::path(job.output).lexically_normal().string();
+            auto named = outputs.emplace(path, lineCount);
+            if (!named.second) {
+                throw std::invalid_argument("Duplicate output " + job.output + " in " + FileName + ":" + std::to_string(lineCount)
+                                            + ", already used at line " + std::to_string(named.first->second));
+            }
+            job.opt.rows = static_cast<unsigned short>(rows);
+            job.opt.cols = static_cast<unsigned short>(cols);
+            job.opt.n_puzzles = static_cast<unsigned int>(count);
+            job.opt.seed = seed;
+            job.opt.armada_file = job.output + "_armada.bp";
+            job.opt.matrix_file = job.output + "_matrix.bp";
+            jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    /*!
+    * Estimates the time a job takes, in microseconds.
+    *
+    * The time per puzzle comes from the measured table job_cost_us. Crowded boards cost the
+    * most: a 7x7 puzzle takes about thirty times as long as a 7x8 one. Past 8x8 the search
+    * and the output both grow with the area, so 16x16 costs four times as much as 8x8. The
+    * randomized search of seeded jobs is charged as the regular one.
+    *
+    * @param opt The options of the job.
+    * @return The estimated cost of the job.
+    */
+    double EstimatedCost(const RunningOpt &opt) {
+        return opt.n_puzzles * double(job_cost_us[opt.rows - min_rows][opt.cols - min_cols]);
+    }
+
+    /*!
+    * Runs jobs on a shared pool of worker threads, most expensive jobs first.
+    *
+    * Jobs that use the regular generator and share a dimension are served by a single
+    * generation: puzzles come out in a fixed order, so a smaller job is a prefix of the
+    * largest one. The largest job of each dimension generates, the others wait for it.
+    * Each job minimizes its own hints when asked to, one thread per job. Seeded jobs stop
+    * after default_job_deadline_ms, so a board too crowded for the randomized search cannot
+    * hold a worker forever; they then write the puzzles found so far.
+    *
+    * @param jobs The jobs to run; their found and elapsed_ms fields are filled in.
+    * @param threads Number of worker threads; zero uses one per hardware thread.
+    */
+    void RunJobs(std::vector<Job> &jobs, unsigned int threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Most expensive first; within a dimension the largest count comes first.
+        std::vector<size_t> order(jobs.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return EstimatedCost(jobs[a].opt) > EstimatedCost(jobs[b].opt);
+        });
+
+        // One shared generation per dimension for the deterministic jobs.
+        using dimension = std::pair<unsigned short, unsigned short>;
+        std::map<dimension, size_t> producer;
+        std::map<dimension, std::promise<PuzzleStore>> promises;
+        std::map<dimension, std::shared_future<PuzzleStore>> shared;
+        for (size_t i : order) {
+            if (jobs[i].opt.seed != 0) {
+                continue;
+            }
+            dimension dim{ jobs[i].opt.rows, jobs[i].opt.cols };
+            if (producer.emplace(dim, i).second) {
+                shared[dim] = promises[dim].get_future().share();
+            }
+        }
+
+        size_t next = 0;
+        std::mutex queueMutex;
+        auto worker = [&]() {
+            while (true) {
+                size_t i;
+                {
+                    std::lock_guard<std::mutex> guard(queueMutex);
+                    if (next == order.size()) {
+                        return;
+                    }
+                    i = order[next++];
+                }
+                Job &job = jobs[i];
+                auto started = std::chrono::steady_clock::now();
+
+                PuzzleStore puzzles;
+                if (job.opt.seed != 0) {
+                    RunningOpt bounded = job.opt;
+                    bounded.deadline_ms = bounded.deadline_ms ? bounded.deadline_ms : default_job_deadline_ms;
+                    GenerationReport report;
+                    puzzles = Generator::generateAnytime(bounded, report);
+                } else {
+                    dimension dim{ job.opt.rows, job.opt.cols };
+                    if (producer.at(dim) == i) {
+                        promises.at(dim).set_value(Generator::generate(job.opt));
+                    }
+                    const PuzzleStore &all = shared.at(dim).get();
+                    puzzles = PuzzleStore(job.opt.rows, job.opt.cols, job.opt.n_puzzles);
+                    for (size_t k = 0; k < all.size() && k < job.opt.n_puzzles; k++) {
+                        puzzles.push(all[k]);
+                    }
+                }
+
+                // Plain files are appended to, and a run with the other --compress setting
+                // would leave a stale file of the other kind next to the new one.
+                for (const std::string &file : { job.opt.armada_file, job.opt.matrix_file }) {
+                    std::remove(file.c_str());
+#ifdef BPG_HAS_ZLIB
+                    std::remove(BlockFileName(file).c_str());
+#endif
+                }
+                std::vector<HintSet> hints;
+                if (job.opt.hints) {
+                    unsigned long checks = 0;
+                    hints = minimizeHints(puzzles, job.opt.seed, 1, checks);
+                }
+                SaveArmada(job.opt, puzzles, hints);
+                SaveMatrix(job.opt, puzzles, hints);
+                job.found = puzzles.size();
+                job.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned int t = 0; t < std::min<size_t>(threads, jobs.size()); t++) {
+            pool.emplace_back(worker);
+        }
+        for (auto &th : pool) {
+            th.join();
+        }
+    }
+
+    /*!
+    * Prints the timing summary of a jobs run.
+    * @param jobs The jobs that were run.
+    */
+    void PrintJobSummary(const std::vector<Job> &jobs) {
+        double total = 0;
+        std::cout << " line   dims  count  found      seed     time(ms)  output" << std::endl;
+        for (const Job &job : jobs) {
+            std::stringstream dims, time;
+            dims << job.opt.rows << 'x' << job.opt.cols;
+            time << std::fixed << std::setprecision(1) << job.elapsed_ms;
+            std::cout << std::setw(5) << job.line << std::setw(7) << dims.str()
+                      << std::setw(7) << job.opt.n_puzzles << std::setw(7) << job.found
+                      << std::setw(10) << job.opt.seed << std::setw(13) << time.str() << "  " << job.output << std::endl;
+            total += job.elapsed_ms;
+        }
+        std::cout << ">>> " << jobs.size() << " jobs, " << total << " ms of job time" << std::endl;
+    }
+}
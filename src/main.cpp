@@ -22,10 +22,30 @@
 #include <iostream> // std::cout, std::endl
 #include <string>
 #include <cstdlib> // exit
+#include <chrono>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
 
+#include "include/blockfile.h"
 #include "include/bpg.h"
 #include "include/common.h"
+#include "include/dedup.h"
 #include "include/file.h"
+#include "include/heatmap.h"
+#include "include/hints.h"
+#include "include/pool.h"
+#include "include/store.h"
+#include "include/memstats.h"
+#include "include/mutate.h"
+#include "include/validator.h"
+#include "include/jobs.h"
+#include "include/zdd.h"
 
 /*!
  * Displays the welcome message for the Battleship Puzzle Game.
@@ -42,9 +62,26 @@ void error_msg() {
   std:: cout << "Usage: [<options>] <number_of_puzzles>" << std::endl << std::endl;
     std:: cout << "Program options are:" << std::endl << std::endl;
     std:: cout << "       --rows <num>	Specify the number of rows for the matrix," << std::endl << "                        with `<num>` in the range [7, 16 ]." << std::endl << "                        The default value is 10." << std::endl;
-    std:: cout << "       --cols <num>	Specify the number of columns for the matrix," << std::endl << "                        with `<num>` in the range [7,16]." << std::endl << "                        The default value is 10." << std::endl << std::endl;    
+    std:: cout << "       --cols <num>	Specify the number of columns for the matrix," << std::endl << "                        with `<num>` in the range [7,16]." << std::endl << "                        The default value is 10." << std::endl;
+    std:: cout << "       --pool <file>	Hand out fresh puzzles from a pre-generated pool file." << std::endl;
+    std:: cout << "       --pool-fill	Pre-generate every dimension of the pool file and quit." << std::endl;
+    std:: cout << "       --validate <file>	Check the puzzles of an armada file and quit." << std::endl;
+    std:: cout << "       --deadline-ms <num>	Stop after `<num>` milliseconds and keep the puzzles found so far." << std::endl;
+    std:: cout << "       --seed <num>	Seed of the randomized search and of ZDD sampling." << std::endl;
+    std:: cout << "       --jobs <file>	Run every job (rows cols count seed output) of a manifest file and quit." << std::endl;
+    std:: cout << "       --engine=<dfs|dlx>	Search engine: head-cell scan (default) or Dancing Links." << std::endl;
+    std:: cout << "       --zdd <prefix>	Sample puzzles uniformly from the layout ZDD `<prefix>_<rows>x<cols>.zdd`," << std::endl << "                        building it if needed." << std::endl;
+    std:: cout << "       --index <k>	With --zdd, output puzzles number k, k+1, ... instead of sampling." << std::endl;
+    std:: cout << "       --zdd-build	With --zdd, build the ZDD of every dimension and quit." << std::endl;
+    std:: cout << "       --dedup-budget <KB>	Memory budget of the duplicate check; beyond it, keys spill to disk." << std::endl;
+    std:: cout << "       --compress	Write block-compressed output files (`.bpz`) instead of plain ones." << std::endl;
+    std:: cout << "       --hints	Add to each puzzle the fewest revealed cells that, with the row and column" << std::endl << "                        counts, make its solution unique." << std::endl;
+    std:: cout << "       --extract <k>	With --validate on a `.bpz` file, print and check only puzzle number k." << std::endl;
+    std:: cout << "       --mutate <moves>	Walk four Markov chains over the layouts and keep a puzzle" << std::endl << "                        every `<moves>` local moves." << std::endl;
+    std:: cout << "       --constraints <file>	Only generate puzzles that cover the `ship <row> <col>` cells of a file" << std::endl << "                        and leave its `water <row> <col>`, `water row <r>`, `water col <c>` cells empty." << std::endl;
+    std:: cout << "       --heatmap <file>	Replay the shots of a file (`row col hit|miss` per line) on a --rows x --cols" << std::endl << "                        board and print the chance of a ship on each cell." << std::endl << std::endl;
     std:: cout << "Requested input is:" << std::endl << std::endl;
-    std:: cout << "       number_of_puzzles	The number of puzzles to be generated" << std::endl << "                                in the range [1,100]."<< std::endl << std::endl;
+    std:: cout << "       number_of_puzzles	The number of puzzles to be generated" << std::endl << "                                in the range [1,100], or up to 10000000 with --dedup-budget."<< std::endl << std::endl;
 }
 
 /*!
@@ -65,6 +102,82 @@ void possibleErrors(int tipo){
     }
 }
 
+/*!
+ * Removes an option followed by a value (`--name value` or `--name=value`) from the command-line arguments.
+ * @param argc The number of command-line arguments, updated when the option is found.
+ * @param argv An array of strings containing the command-line arguments.
+ * @param name The option name, such as "--pool".
+ * @param value Receives the value that follows the option.
+ * @return True if the option was found, false otherwise.
+ */
+bool extract_option(int &argc, char *argv[], const std::string &name, std::string &value) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, name.size() + 1, name + "=") == 0) {   // --name=value
+      value = arg.substr(name.size() + 1);
+      for (int j = i; j + 1 < argc; j++) {
+        argv[j] = argv[j + 1];
+      }
+      argc -= 1;
+      return true;
+    }
+    if (arg != name) {
+      continue;
+    }
+    if (i + 1 >= argc) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+    value = argv[i + 1];
+    for (int j = i; j + 2 < argc; j++) {
+      argv[j] = argv[j + 2];
+    }
+    argc -= 2;
+    return true;
+  }
+  return false;
+}
+
+/*!
+ * Removes a flag (an option without value) from the command-line arguments.
+ * @param argc The number of command-line arguments, updated when the flag is found.
+ * @param argv An array of strings containing the command-line arguments.
+ * @param name The flag name, such as "--pool-fill".
+ * @return True if the flag was found, false otherwise.
+ */
+bool extract_flag(int &argc, char *argv[], const std::string &name) {
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] != name) {
+      continue;
+    }
+    for (int j = i; j + 1 < argc; j++) {
+      argv[j] = argv[j + 1];
+    }
+    argc -= 1;
+    return true;
+  }
+  return false;
+}
+
+/*!
+ * Reads the number of puzzles. It is at most max_n_puzzles, or max_n_puzzles_budgeted when
+ * --dedup-budget bounds the memory of the duplicate check (the pool keeps its own count).
+ *
+ * @param arg The argument holding the number.
+ * @param opt The options read so far.
+ * @return The number of puzzles.
+ */
+unsigned int read_n_puzzles(const char *arg, const RunningOpt &opt) {
+  long n = std::stol(arg);
+  long cap = opt.dedup_budget_kb > 0 and opt.pool_file.empty() ? long(max_n_puzzles_budgeted) : long(max_n_puzzles);
+  if (n < 0 or n > cap) {
+    possibleErrors(4);
+    throw std::invalid_argument("Invalid number of puzzles");
+  }
+  return static_cast<unsigned int>(n);
+}
+
 /*!
  * Validates the input arguments for the Battleship Puzzle Game.
  * @param argc The number of command-line arguments.
@@ -77,14 +190,178 @@ RunningOpt validate_input(int argc, char *argv[]) {
   saida.cols = 10;
   std :: string rows = "--rows";
   std :: string cols = "--cols";
+
+  extract_option(argc, argv, "--pool", saida.pool_file);
+  saida.pool_fill = extract_flag(argc, argv, "--pool-fill");
+  extract_option(argc, argv, "--validate", saida.validate_file);
+  extract_option(argc, argv, "--jobs", saida.jobs_file);
+  saida.compress = extract_flag(argc, argv, "--compress");
+  saida.hints = extract_flag(argc, argv, "--hints");
+  extract_option(argc, argv, "--constraints", saida.constraints_file);
+  std::string extract;
+  if (extract_option(argc, argv, "--extract", extract)) {
+    try {
+      long k = std::stol(extract);
+      if (k <= 0 or saida.validate_file.empty()) {
+        throw std::invalid_argument("Invalid puzzle number");
+      }
+      saida.extract = static_cast<std::size_t>(k);
+    } catch (const std::exception& e) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+  }
+#ifndef BPG_HAS_ZLIB
+  if (saida.compress or saida.extract > 0) {
+    std::cerr << "bpg was built without zlib: --compress and --extract are not available" << std::endl;
+    exit(1);
+  }
+#endif
+  std::string seed;
+  if (extract_option(argc, argv, "--seed", seed)) {
+    try {
+      saida.seed = static_cast<unsigned int>(std::stoul(seed));
+    } catch (const std::exception& e) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+  }
+  extract_option(argc, argv, "--zdd", saida.zdd_prefix);
+  extract_option(argc, argv, "--index", saida.zdd_index);
+  saida.zdd_build = extract_flag(argc, argv, "--zdd-build");
+  if ((saida.zdd_build or not saida.zdd_index.empty()) and saida.zdd_prefix.empty()) {
+    possibleErrors(1);
+    error_msg();
+    exit(1);
+  }
+  std::string engine;
+  if (extract_option(argc, argv, "--engine", engine)) {
+    if (engine == "dlx") {
+      saida.engine = engine_t::dlx;
+    } else if (engine != "dfs") {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+  }
+  std::string budget;
+  if (extract_option(argc, argv, "--dedup-budget", budget)) {
+    try {
+      long kb = std::stol(budget);
+      if (kb <= 0) {
+        throw std::invalid_argument("Invalid budget");
+      }
+      saida.dedup_budget_kb = static_cast<std::size_t>(kb);
+    } catch (const std::exception& e) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+  }
+  std::string deadline;
+  if (extract_option(argc, argv, "--deadline-ms", deadline)) {
+    try {
+      int ms = std::stoi(deadline);
+      if (ms <= 0) {
+        throw std::invalid_argument("Invalid deadline");
+      }
+      saida.deadline_ms = static_cast<unsigned int>(ms);
+    } catch (const std::exception& e) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+  }
+  std::string moves;
+  if (extract_option(argc, argv, "--mutate", moves)) {
+    try {
+      int m = std::stoi(moves);
+      if (m <= 0) {
+        throw std::invalid_argument("Invalid number of moves");
+      }
+      saida.mutate_moves = static_cast<unsigned int>(m);
+    } catch (const std::exception& e) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+  }
+  if (extract_option(argc, argv, "--heatmap", saida.heatmap_file)) {
+    // The board size comes with --rows and --cols, in any order; no puzzle count.
+    std::string size;
+    try {
+      if (extract_option(argc, argv, rows, size)) {
+        saida.rows = static_cast<unsigned short>(std::stoi(size));
+      }
+      if (extract_option(argc, argv, cols, size)) {
+        saida.cols = static_cast<unsigned short>(std::stoi(size));
+      }
+    } catch (const std::exception& e) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+    int error = 0;
+    if (saida.rows < min_rows or saida.rows > max_rows) {
+      error = 2;
+    } else if (saida.cols < min_cols or saida.cols > max_cols) {
+      error = 3;
+    } else if (argc != 1) {
+      error = 1;
+    }
+    if (error) {
+      possibleErrors(error);
+      error_msg();
+      exit(1);
+    }
+    return saida;
+  }
+  // Constraints are checked by Puzzle::addShip, which only the head-cell searches use.
+  if (not saida.constraints_file.empty()
+      and (saida.engine == engine_t::dlx or not saida.zdd_prefix.empty() or not saida.pool_file.empty()
+           or not saida.jobs_file.empty())) {
+    possibleErrors(1);
+    error_msg();
+    exit(1);
+  }
+  // The deadline bounds the randomized search and the Markov chains; the other sources have no
+  // way to stop early and would silently lose either the deadline or the user's choice.
+  if (saida.deadline_ms > 0
+      and (saida.engine == engine_t::dlx or not saida.zdd_prefix.empty() or not saida.pool_file.empty())) {
+    possibleErrors(1);
+    error_msg();
+    exit(1);
+  }
+  // Each job of a manifest has its own seed, and the jobs that share a regular generation
+  // cannot stop early, so neither option has a meaning for the whole run.
+  if (not saida.jobs_file.empty() and (saida.seed != 0 or saida.deadline_ms > 0)) {
+    possibleErrors(1);
+    error_msg();
+    exit(1);
+  }
+  // Chains start from the head-cell search and hand their puzzles straight to the output.
+  if (saida.mutate_moves > 0
+      and (saida.engine == engine_t::dlx or not saida.zdd_prefix.empty() or not saida.pool_file.empty()
+           or not saida.jobs_file.empty())) {
+    possibleErrors(1);
+    error_msg();
+    exit(1);
+  }
+  if (saida.pool_fill or saida.zdd_build or not saida.validate_file.empty() or not saida.jobs_file.empty()) {
+    if ((saida.pool_fill and saida.pool_file.empty()) or argc != 1) {
+      possibleErrors(1);
+      error_msg();
+      exit(1);
+    }
+    return saida;
+  }
+
   switch (argc){
     case 2:      // ./bpg n_puzzles
         try {
-            saida.n_puzzles = std::stoi(argv[1]);
-            if (saida.n_puzzles > 100) {
-                possibleErrors(4);
-                throw std::invalid_argument("Invalid number of puzzles");
-            }
+            saida.n_puzzles = read_n_puzzles(argv[1], saida);
         } catch (const std::exception& e) {
             error_msg();
             exit(1);
@@ -99,11 +376,7 @@ RunningOpt validate_input(int argc, char *argv[]) {
                     possibleErrors(2);
                     throw std::invalid_argument("Invalid number of rows");
                 }
-                saida.n_puzzles = std::stoi(argv[3]);
-                if (saida.n_puzzles > 100) {
-                    possibleErrors(4);
-                    throw std::invalid_argument("Invalid number of puzzles");
-                }
+                saida.n_puzzles = read_n_puzzles(argv[3], saida);
             } catch (const std::exception& e) {
                 error_msg();
                 exit(1);
@@ -116,11 +389,7 @@ RunningOpt validate_input(int argc, char *argv[]) {
                     possibleErrors(3);
                     throw std::invalid_argument("Invalid number of columns");
                 }
-                saida.n_puzzles = std::stoi(argv[3]);
-                if (saida.n_puzzles > 100) {
-                    possibleErrors(4);
-                    throw std::invalid_argument("Invalid number of puzzles");
-                }
+                saida.n_puzzles = read_n_puzzles(argv[3], saida);
             } catch (const std::exception& e) {
                 error_msg();
                 exit(1);
@@ -146,11 +415,7 @@ RunningOpt validate_input(int argc, char *argv[]) {
                     possibleErrors(3);
                     throw std::invalid_argument("Invalid number of columns");
                 }
-                saida.n_puzzles = std::stoi(argv[5]);
-                if (saida.n_puzzles > 100) {
-                    possibleErrors(4);
-                    throw std::invalid_argument("Invalid number of puzzles");
-                }
+                saida.n_puzzles = read_n_puzzles(argv[5], saida);
             } catch (const std::exception& e) {
                 error_msg();
                 exit(1);
@@ -169,19 +434,318 @@ RunningOpt validate_input(int argc, char *argv[]) {
         exit(1);
         break;
     }
+  if (not saida.constraints_file.empty()) {
+    try {
+      bpg::ReadConstraints(saida.constraints_file, saida);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+  }
   return saida;
 }
 
 /*!
 
- * Saves the puzzles in both Armada and Matrix formats.
+ * Saves the puzzles in both Armada and Matrix formats, with their hints if requested.
  
  * @param run_opt The running options containing the dimensions of the puzzle.
- * @param puzzles The list of puzzles to be saved.
+ * @param puzzles The store of puzzles to be saved.
 */
-void save_puzzles(const RunningOpt &run_opt, const std::list<bpg::Puzzle> &puzzles) {
-    SaveArmada(run_opt, puzzles);
-    SaveMatrix(run_opt, puzzles);
+void save_puzzles(const RunningOpt &run_opt, const bpg::PuzzleStore &puzzles) {
+    std::vector<bpg::HintSet> hints;
+    if (run_opt.hints) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+        unsigned long checks = 0;
+        hints = bpg::minimizeHints(puzzles, run_opt.seed, threads, checks);
+        size_t total = 0, water = 0, none = 0;
+        for (const bpg::HintSet &set : hints) {
+            total += set.size();
+            none += set.empty() ? 1 : 0;
+            for (const bpg::Hint &hint : set) {
+                water += hint.kind == bpg::hint_t::water ? 1 : 0;
+            }
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << ">>> Hints: " << total << " (" << water << " water) for " << puzzles.size() << " puzzles, "
+                  << checks << " uniqueness checks in " << elapsed.count() << " ms" << std::endl;
+        std::cout << ">>> Every set is irreducible (no hint can be removed), with water cells tried as hints too";
+        if (none > 0) {
+            std::cout << "; " << none << " puzzles need no hints (`hints 0`): the counts alone fix them";
+        }
+        std::cout << std::endl;
+    }
+    SaveArmada(run_opt, puzzles, hints);
+    SaveMatrix(run_opt, puzzles, hints);
+}
+
+#ifdef BPG_HAS_ZLIB
+/*!
+ * Prints and checks a single puzzle of a block-compressed armada file.
+ *
+ * Only the block holding the puzzle is decompressed, through the block index.
+ *
+ * @param run_opt The running options containing the file and the puzzle number.
+ * @return The number of invalid puzzles (0 or 1).
+ */
+size_t extract_puzzle(const RunningOpt &run_opt) {
+  std::string text;
+  if (not bpg::IsBlockFile(run_opt.validate_file)
+      or not bpg::ReadBlockPuzzle(run_opt.validate_file, run_opt.extract - 1, text)) {
+    std::cerr << "No puzzle " << run_opt.extract << " in block file: " << run_opt.validate_file << std::endl;
+    return 1;
+  }
+  std::cout << text;
+  std::istringstream in(text);
+  std::vector<bpg::ArmadaLayout> layouts = bpg::ParseArmada(in);
+  bpg::validateLayouts(layouts);
+  if (layouts.size() != 1 or layouts[0].error != bpg::layout_error::none) {
+    std::cout << ">>> Puzzle " << run_opt.extract << ": "
+              << (layouts.size() == 1 ? bpg::errorToString(layouts[0].error) : "not an armada") << std::endl;
+    return 1;
+  }
+  std::cout << ">>> Puzzle " << run_opt.extract << ": valid" << std::endl;
+  return 0;
+}
+#endif
+
+/*!
+ * Validates the puzzles of an armada file and reports the ones that break the rules.
+ *
+ * Every validation path is also timed on the same layouts, so the bitboard
+ * validators can be compared with the reference Puzzle::addShip path.
+ *
+ * @param run_opt The running options containing the armada file to validate.
+ * @return The number of invalid puzzles.
+ */
+size_t validate_puzzles(const RunningOpt &run_opt) {
+#ifdef BPG_HAS_ZLIB
+  if (run_opt.extract > 0) {
+    return extract_puzzle(run_opt);
+  }
+#endif
+  const std::vector<bpg::ArmadaLayout> layouts = bpg::ReadArmada(run_opt.validate_file);
+  std::vector<bpg::ArmadaLayout> checked = layouts;
+  bpg::validateLayouts(checked);
+
+  size_t invalid = 0;
+  for (size_t i = 0; i < checked.size(); i++) {
+    if (checked[i].error != bpg::layout_error::none) {
+      std::cout << "Puzzle " << i + 1 << " (" << checked[i].rows << "x" << checked[i].cols << "): "
+                << bpg::errorToString(checked[i].error) << std::endl;
+      invalid++;
+    }
+  }
+  std::cout << ">>> " << checked.size() - invalid << " valid, " << invalid << " invalid puzzles" << std::endl;
+  if (layouts.empty()) {
+    return invalid;
+  }
+
+  const std::pair<bpg::validator_path, std::string> paths[] = {
+    { bpg::validator_path::scalar, "scalar (addShip)" },
+    { bpg::validator_path::bitboard, "bitboard" },
+    { bpg::validator_path::avx2, bpg::BatchValidator::hasAvx2() ? "avx2" : "avx2 (unsupported, bitboard)" }
+  };
+  for (const auto &[path, name] : paths) {
+    // Repeat the whole batch until the measurement is long enough to be meaningful.
+    size_t done = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{0};
+    while (elapsed.count() < 0.2) {
+      std::vector<bpg::ArmadaLayout> batch = layouts;
+      bpg::validateLayouts(batch, path);
+      done += batch.size();
+      elapsed = std::chrono::steady_clock::now() - start;
+    }
+    std::cout << ">>> " << name << ": " << elapsed.count() * 1e9 / done << " ns/puzzle" << std::endl;
+  }
+  return invalid;
+}
+
+/*!
+ * Replays the shots of a file on an empty board, refreshing the heatmap after each one,
+ * and prints the final heatmap with the most likely cell to shoot next.
+ *
+ * Each line of the file holds `row col hit` or `row col miss`, counting from zero;
+ * blank lines and lines starting with `#` are skipped.
+ *
+ * @param run_opt The running options containing the shots file and the board size.
+ * @return True on success, false if the file is missing or holds an invalid shot.
+ */
+bool heatmap_shots(const RunningOpt &run_opt) {
+  std::ifstream in(run_opt.heatmap_file);
+  if (not in.is_open()) {
+    std::cerr << "Error trying to open file: " << run_opt.heatmap_file << std::endl;
+    return false;
+  }
+  bpg::HeatmapEngine engine(run_opt.rows, run_opt.cols, 0, run_opt.seed);
+  bpg::Heatmap map = engine.refresh();
+  std::string line;
+  for (size_t number = 1; std::getline(in, line); number++) {
+    std::istringstream fields(line);
+    bpg::Shot shot;
+    std::string result;
+    if (not (fields >> result) or result[0] == '#') {
+      continue;
+    }
+    fields.clear();
+    fields.str(line);
+    if (not (fields >> shot.row >> shot.col >> result) or (result != "hit" and result != "miss")) {
+      std::cerr << "Invalid shot at line " << number << " of " << run_opt.heatmap_file << std::endl;
+      return false;
+    }
+    shot.hit = result == "hit";
+    if (not engine.shoot(shot)) {
+      std::cerr << "Shot outside the board or repeated at line " << number << " of " << run_opt.heatmap_file << std::endl;
+      return false;
+    }
+    map = engine.refresh();
+    std::cout << ">>> Shot " << shot.row << " " << shot.col << " " << result << ": ";
+    if (map.exact) {
+      std::cout << "exact, " << map.layouts << " layouts";
+    } else {
+      std::cout << "sampled, ~" << map.layouts << " layouts from " << map.samples << " samples";
+      if (not map.reliable) {
+        std::cout << " (unreliable)";
+      }
+    }
+    std::cout << ", " << map.elapsed_ms << " ms" << std::endl;
+  }
+
+  // Shot cells are drawn as X (hit) or ~ (miss), the others as percentages.
+  std::vector<char> shots(map.probability.size(), 0);
+  for (const bpg::Shot &shot : engine.shots()) {
+    shots[shot.row * run_opt.cols + shot.col] = shot.hit ? 'X' : '~';
+  }
+  int best = -1;
+  std::cout << std::endl << "    ";
+  for (int c = 0; c < run_opt.cols; c++) {
+    std::cout << std::setw(4) << c;
+  }
+  std::cout << std::endl;
+  for (int r = 0; r < run_opt.rows; r++) {
+    std::cout << std::setw(4) << r;
+    for (int c = 0; c < run_opt.cols; c++) {
+      int i = r * run_opt.cols + c;
+      if (shots[i]) {
+        std::cout << std::setw(4) << shots[i];
+        continue;
+      }
+      std::cout << std::setw(4) << int(map.probability[i] * 100 + 0.5);
+      if (best < 0 or map.probability[i] > map.probability[best]) {
+        best = i;
+      }
+    }
+    std::cout << std::endl;
+  }
+  if (map.layouts == 0 or best < 0 or map.probability[best] == 0) {
+    std::cout << std::endl << ">>> No layout agrees with the shots" << (map.exact ? "" : " among the samples drawn") << std::endl;
+  } else {
+    std::cout << std::endl << ">>> Best shot: " << best / run_opt.cols << " " << best % run_opt.cols
+              << " (" << map.probability[best] * 100 << "%)" << std::endl;
+  }
+  if (not map.reliable) {
+    std::cout << ">>> Unreliable heatmap: only " << map.samples
+              << " sampled layouts; percentages may be far off" << std::endl;
+  }
+  return true;
+}
+
+/*!
+ * Opens the layout ZDD of a dimension, building and saving it first if needed.
+ *
+ * @param zdd The diagram to open.
+ * @param prefix The prefix of the ZDD file names.
+ * @param rows The number of rows of the layouts.
+ * @param cols The number of columns of the layouts.
+ * @return True if the diagram is ready, false if it could not be built within the budget.
+ */
+bool open_zdd(bpg::LayoutZdd &zdd, const std::string &prefix, int rows, int cols) {
+  std::string file = prefix + "_" + std::to_string(rows) + "x" + std::to_string(cols) + ".zdd";
+  if (not bpg::LayoutZdd::supported(rows, cols)) {
+    std::cout << ">>> ZDD " << rows << "x" << cols << ": too large to build (the narrower side must be at most 10, or the board 11x11)"
+              << std::endl;
+    return false;
+  }
+  if (zdd.open(file, rows, cols)) {
+    std::cout << ">>> ZDD " << rows << "x" << cols << ": loaded " << file;
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    if (not zdd.build(rows, cols)) {
+      std::cout << ">>> ZDD " << rows << "x" << cols << ": more than " << zdd_max_states
+                << " states, too large to build" << std::endl;
+      return false;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (not zdd.save(file)) {
+      std::cerr << "Error trying to save file: " << file << std::endl;
+    }
+    std::cout << ">>> ZDD " << rows << "x" << cols << ": built in " << elapsed.count() << " ms";
+  }
+  std::cout << ", " << zdd.nodeCount() << " nodes, " << bpg::countToString(zdd.count()) << " layouts" << std::endl;
+  return true;
+}
+
+/*!
+ * Takes puzzles from the layout ZDD: numbers k, k+1, ... if an index was given,
+ * distinct uniformly sampled layouts otherwise. When the diagram of the dimension is too
+ * large to build, sampling falls back to the randomized search.
+ *
+ * @param run_opt The running options containing the ZDD prefix and index.
+ * @param puzzles Receives the puzzles.
+ * @return True on success, false if an index was given and the ZDD is not available.
+ */
+bool zdd_puzzles(const RunningOpt &run_opt, bpg::PuzzleStore &puzzles) {
+  bpg::LayoutZdd zdd;
+  if (not open_zdd(zdd, run_opt.zdd_prefix, run_opt.rows, run_opt.cols)) {
+    if (not run_opt.zdd_index.empty()) {
+      return false;
+    }
+    // Without a diagram the randomized search still gives distinct layouts, spread over
+    // the board but not exactly uniform.
+    RunningOpt bounded = run_opt;
+    bounded.deadline_ms = bounded.deadline_ms ? bounded.deadline_ms : default_job_deadline_ms;
+    bpg::GenerationReport report;
+    puzzles = bpg::Generator::generateAnytime(bounded, report);
+    std::cout << ">>> Sampled " << report.found << " of " << report.requested
+              << " puzzles with the randomized search instead (not exactly uniform, no puzzle numbers)"
+              << std::endl;
+    return true;
+  }
+  bpg::zdd_count total = zdd.count();
+  puzzles = bpg::PuzzleStore(run_opt.rows, run_opt.cols, run_opt.n_puzzles);
+
+  if (not run_opt.zdd_index.empty()) {
+    bpg::zdd_count k = 0;
+    for (char d : run_opt.zdd_index) {
+      if (d < '0' or d > '9') {
+        possibleErrors(1);
+        return false;
+      }
+      k = k * 10 + bpg::zdd_count(d - '0');
+    }
+    for (; k < total and puzzles.size() < run_opt.n_puzzles; k++) {
+      puzzles.push(zdd.unrank(k));
+    }
+  } else {
+    std::mt19937_64 rng(run_opt.seed ? run_opt.seed : std::random_device{}());
+    bpg::Deduplicator pzKeys(run_opt.dedup_budget_kb * 1024);
+    while (puzzles.size() < run_opt.n_puzzles and bpg::zdd_count(pzKeys.size()) < total) {
+      bpg::PuzzleRecord rec = zdd.sample(rng);
+      if (pzKeys.insert(rec)) {
+        puzzles.push(rec);
+      }
+    }
+  }
+
+  std::cout << ">>> Puzzle numbers:";
+  for (const bpg::PuzzleRecord &rec : puzzles) {
+    bpg::zdd_count k;
+    std::cout << ' ' << (zdd.rank(rec, k) ? bpg::countToString(k) : "?");
+  }
+  std::cout << std::endl;
+  return true;
 }
 
 int main(int argc, char *argv[]) {
@@ -191,12 +755,106 @@ int main(int argc, char *argv[]) {
   // [2] Read and validate the running options passed as arguments.
   RunningOpt run_opt = validate_input(argc, argv);
   
-  // [3] Generate all puzzles.
-    auto puzzles = bpg::Generator::generate(run_opt);
+  if (not run_opt.validate_file.empty()) {
+    return validate_puzzles(run_opt) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (not run_opt.heatmap_file.empty()) {
+    return heatmap_shots(run_opt) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (run_opt.zdd_build) {
+    for (int r = min_rows; r <= max_rows; r++) {
+      for (int c = min_cols; c <= max_cols; c++) {
+        bpg::LayoutZdd zdd;
+        open_zdd(zdd, run_opt.zdd_prefix, r, c);
+      }
+    }
+    std::cout << ">>> Job finished!\n\n";
+    return EXIT_SUCCESS;
+  }
+  if (not run_opt.jobs_file.empty()) {
+    try {
+      auto jobs = bpg::ReadManifest(run_opt.jobs_file);
+      for (auto &job : jobs) {
+        job.opt.engine = run_opt.engine;
+        job.opt.compress = run_opt.compress;
+        job.opt.hints = run_opt.hints;
+        job.opt.dedup_budget_kb = run_opt.dedup_budget_kb;
+      }
+      bpg::RunJobs(jobs);
+      bpg::PrintJobSummary(jobs);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << ">>> Job finished!\n\n";
+    return EXIT_SUCCESS;
+  }
+
+  // [3] Generate all puzzles, or take them from the pool.
+  bpg::PuzzleStore puzzles;
+  std::unique_ptr<bpg::PuzzlePool> pool;
+  if (run_opt.mutate_moves > 0) {
+    bpg::MutationReport report;
+    puzzles = bpg::Generator::generateMutate(run_opt, report);
+    std::chrono::duration<double> elapsed(report.elapsed_ms / 1000);
+    std::cout << ">>> Found " << report.found << " of " << report.requested << " requested puzzles in "
+              << report.elapsed_ms << " ms (" << report.found / elapsed.count() << " puzzles/s, "
+              << report.chains << " chains, " << report.moves << " moves"
+              << (report.deadline_hit ? ", deadline reached" : "") << ")" << std::endl;
+    if (report.found < report.requested and not report.deadline_hit) {
+      std::cout << ">>> Short by " << report.requested - report.found << " puzzles: "
+                << (report.found == 0 and report.moves == 0 ? "no layout fits the board"
+                                                             : "every chain stopped finding new layouts")
+                << std::endl;
+    }
+    const char *names[] = { "relocate", "rotate", "swap" };
+    std::cout << ">>> Accepted moves:";
+    for (std::size_t k = 0; k < 3; k++) {
+      std::cout << ' ' << names[k] << ' '
+                << (report.proposed[k] ? 100.0 * report.accepted[k] / report.proposed[k] : 0) << '%';
+    }
+    std::cout << std::endl << ">>> Mixing: " << 100 * report.overlap << "% ship cells kept between samples, "
+              << "lag-1 autocorrelation " << report.autocorrelation << ", R-hat ";
+    if (report.rhat > 0) {
+      std::cout << report.rhat << std::endl;
+    } else {
+      std::cout << "n/a" << std::endl;
+    }
+  } else if (run_opt.deadline_ms > 0) {
+    bpg::GenerationReport report;
+    puzzles = bpg::Generator::generateAnytime(run_opt, report);
+    std::cout << ">>> Found " << report.found << " of " << report.requested << " requested puzzles in "
+              << report.elapsed_ms << " ms (" << report.restarts << " restarts"
+              << (report.deadline_hit ? ", deadline reached" : "") << ")" << std::endl;
+  } else if (not run_opt.zdd_prefix.empty()) {
+    if (not zdd_puzzles(run_opt, puzzles)) {
+      return EXIT_FAILURE;
+    }
+  } else if (run_opt.pool_file.empty()) {
+    puzzles = bpg::Generator::generate(run_opt);
+  } else {
+    try {
+      pool = std::make_unique<bpg::PuzzlePool>(run_opt.pool_file);
+      if (run_opt.pool_fill) {
+        pool->fillAll();
+        std::cout << ">>> Job finished!\n\n";
+        return EXIT_SUCCESS;
+      }
+      // Puzzles handed out now are replaced in the background while the output is written;
+      // the pool waits for that refill when it is closed.
+      pool->startRefill(default_pool_low_watermark);
+      puzzles = pool->take(run_opt.rows, run_opt.cols, run_opt.n_puzzles);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
 
   // [4] Send puzzles to output
     save_puzzles(run_opt, puzzles);
-  std::cout << ">>> Job finished!\n\n";
+  std::cout << ">>> Job finished!\n";
+  std::cout << ">>> " << puzzles.size() << " puzzles, peak RSS " << bpg::peakRssKb()
+            << " KB, " << bpg::allocationCount() << " allocations\n\n";
 
   return EXIT_SUCCESS;
 }
\ No newline at end of file
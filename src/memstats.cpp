@@ -0,0 +1,52 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <sys/resource.h>
+
+#include "include/memstats.h"
+
+namespace {
+  std::atomic<std::size_t> allocations{0};
+}
+
+/// Counting replacements of the global allocation functions.
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace bpg{
+
+/**
+ * @brief Returns how many times operator new was called.
+ *
+ * @return The number of heap allocations so far.
+ */
+  std::size_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+  }
+
+/**
+ * @brief Returns the peak resident set size of the process.
+ *
+ * @return The peak RSS in kilobytes, as reported by getrusage.
+ */
+  long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  }
+
+}
@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/dedup.h"
+#include "include/mutate.h"
+#include "include/store.h"
+
+namespace bpg{
+
+  namespace {
+    constexpr unsigned long burn_in_moves{ 1000 };   //!< Moves of a chain before its first sample.
+    constexpr unsigned long stall_samples{ 1000 };   //!< Samples in a row without a new puzzle before a chain gives up.
+    constexpr unsigned int chain_count{ 4 };         //!< Chains of a run, the same on every machine.
+    constexpr std::size_t batch_samples{ 64 };       //!< Most samples a chain takes per round.
+
+    /// Samples taken by one chain, for the mixing diagnostics.
+    struct ChainTrace {
+      std::vector<double> rows;   //!< Row of the battleship's centre at each sample.
+      double overlap = 0;         //!< Sum of the overlaps between consecutive samples.
+      std::array<unsigned long, 3> proposed{}, accepted{};
+    };
+
+    double battleshipRow(const Puzzle &pz) {
+      const Ship &ship = pz.puzzleShips[0];
+      return ship.shipHeadCell.row + (ship.shipOrientation == Ship::orientation::V ? (ship.shipSize - 1) / 2.0 : 0.0);
+    }
+  }
+
+/**
+ * @brief Starts a chain at a valid layout.
+ *
+ * @param opt The running options; the board size and the constraints are taken from them.
+ * @param start The first layout; it must fit the board and the constraints.
+ * @param seed The seed of the moves.
+ */
+  MarkovChain::MarkovChain(const RunningOpt &opt, const PuzzleRecord &start, unsigned int seed)
+    : chainPz(opt.cols, opt.rows), chainRng(seed) {
+    chainPz.setRequired(opt.required);
+    chainPz.puzzleForbidden = opt.forbidden;
+    start.toPuzzle(chainPz);
+  }
+
+/**
+ * @brief Returns the cells covered by a ship.
+ */
+  CellMask MarkovChain::occupied() const {
+    CellMask cells{};
+    for (short r = 0; r < chainPz.puzzleRows; r++) {
+      for (short c = 0; c < chainPz.puzzleCols; c++) {
+        if (not chainPz.isLocationWater(Cell(r, c))) {
+          cells[r] |= std::uint16_t(1u << c);
+        }
+      }
+    }
+    return cells;
+  }
+
+/**
+ * @brief Proposes a random move and makes it if the layout stays valid.
+ *
+ * The kind of move is drawn uniformly. Relocations and swaps pick their ships
+ * uniformly; rotations pick among the ships longer than one cell.
+ *
+ * @return True if the move was made, false if the layout did not change.
+ */
+  bool MarkovChain::step() {
+    const std::vector<Ship> &ships = chainPz.puzzleShips;
+    auto kind = move_t(chainRng() % 3);
+    std::size_t i = chainRng() % ships.size();
+    bool moved = false;
+    switch (kind) {
+    case move_t::relocate:
+      moved = relocate(i);
+      break;
+    case move_t::rotate:
+      i = chainRng() % std::size_t(std::count_if(ships.cbegin(), ships.cend(), [](const Ship &s) {
+            return s.shipType != cell_t::submarine;
+          }));
+      moved = rotate(i);
+      break;
+    case move_t::swap: {
+      std::size_t j = chainRng() % ships.size();
+      while (ships[j].shipType == ships[i].shipType) {
+        j = chainRng() % ships.size();
+      }
+      moved = swap(i, j);
+      break;
+    }
+    }
+    chainProposed[std::size_t(kind)]++;
+    chainAccepted[std::size_t(kind)] += moved ? 1 : 0;
+    return moved;
+  }
+
+/**
+ * @brief Replaces ships by new placements, or leaves the board as it was.
+ *
+ * The old ships are removed first, so the new placements are only checked against the
+ * ships that stay. The move is refused if addShip refuses a new placement or if a
+ * required cell is left uncovered; the old ships are then put back, which always works
+ * since the board is the one they were on.
+ *
+ * @param index The indices of the ships in the armada.
+ * @param moved Their new placements.
+ * @param count The number of ships moved (1 or 2).
+ * @return True if the ships were moved.
+ */
+  bool MarkovChain::apply(const std::array<std::size_t, 2> &index, const std::array<Ship, 2> &moved, std::size_t count) {
+    std::vector<Ship> &ships = chainPz.puzzleShips;
+    for (std::size_t k = 0; k < count; k++) {
+      chainPz.removeShip(ships[index[k]]);
+    }
+    std::size_t placed = 0;
+    while (placed < count and chainPz.addShip(moved[placed])) {
+      placed++;
+    }
+    if (placed == count and chainPz.canCoverRequired(ships.size())) {
+      for (std::size_t k = 0; k < count; k++) {
+        ships[index[k]] = moved[k];
+      }
+      return true;
+    }
+    while (placed > 0) {
+      chainPz.removeShip(moved[--placed]);
+    }
+    for (std::size_t k = 0; k < count; k++) {
+      chainPz.addShip(ships[index[k]]);
+    }
+    return false;
+  }
+
+/**
+ * @brief Moves a ship to a random head cell and orientation anywhere on the board.
+ */
+  bool MarkovChain::relocate(std::size_t i) {
+    Ship ship = chainPz.puzzleShips[i];
+    ship.shipHeadCell = Cell(short(chainRng() % std::size_t(chainPz.puzzleRows)),
+                             short(chainRng() % std::size_t(chainPz.puzzleCols)));
+    if (ship.shipType != cell_t::submarine) {
+      ship.shipOrientation = (chainRng() & 1) ? Ship::orientation::V : Ship::orientation::H;
+    }
+    return apply({ i, 0 }, { ship, ship }, 1);
+  }
+
+/**
+ * @brief Turns a ship around a random cell of its body.
+ *
+ * The pivot keeps its offset from the head, so turning back around the same cell
+ * undoes the move.
+ */
+  bool MarkovChain::rotate(std::size_t i) {
+    Ship ship = chainPz.puzzleShips[i];
+    short k = short(chainRng() % std::size_t(ship.shipSize));
+    Cell head = ship.shipHeadCell;
+    if (ship.shipOrientation == Ship::orientation::H) {
+      ship.shipHeadCell = Cell(head.row - k, head.col + k);
+      ship.shipOrientation = Ship::orientation::V;
+    } else {
+      ship.shipHeadCell = Cell(head.row + k, head.col - k);
+      ship.shipOrientation = Ship::orientation::H;
+    }
+    return apply({ i, 0 }, { ship, ship }, 1);
+  }
+
+/**
+ * @brief Exchanges the head cells of two ships of different sizes.
+ *
+ * Each ship also takes the orientation of the other, unless one of them is a submarine;
+ * then both keep their own. Swapping the same two ships again undoes the move.
+ */
+  bool MarkovChain::swap(std::size_t i, std::size_t j) {
+    Ship a = chainPz.puzzleShips[i];
+    Ship b = chainPz.puzzleShips[j];
+    std::swap(a.shipHeadCell, b.shipHeadCell);
+    if (a.shipType != cell_t::submarine and b.shipType != cell_t::submarine) {
+      std::swap(a.shipOrientation, b.shipOrientation);
+    }
+    return apply({ i, j }, { a, b }, 2);
+  }
+
+/**
+ * @brief Generates distinct puzzles by walking Markov chains over the layouts.
+ *
+ * Each of the chain_count chains starts at a layout of its own seeded run of the anytime
+ * search, walks burn_in_moves moves, and then samples its layout every opt.mutate_moves
+ * moves; samples not seen before become puzzles. Chains sample up to batch_samples
+ * layouts per round on their own threads, and the samples of a round go through the
+ * duplicate check in chain order, so a seed gives the same puzzles on every machine
+ * unless the deadline stops the run. A chain gives up after stall_samples samples in a
+ * row without a new puzzle, so small boards with few layouts still finish; the others go
+ * on without it, and the run falls short only when every chain gave up or the deadline
+ * passed. Cells of opt.forbidden are never covered and every sample covers the cells of
+ * opt.required.
+ *
+ * Mixing is reported from the samples of every chain: the share of ship cells kept
+ * between consecutive samples, the lag-1 autocorrelation of the battleship row (the
+ * largest ship moves the least), and the Gelman-Rubin statistic of that row across
+ * chains, which gets close to 1 once the chains forgot where they started.
+ *
+ * @param opt The running options; opt.deadline_ms bounds the running time (zero for no bound).
+ * @param report Receives how many puzzles were found and how the chains mixed.
+ * @return A store with the puzzles found, possibly fewer than requested.
+ */
+  PuzzleStore Generator::generateMutate(const RunningOpt &opt, MutationReport &report) {
+    auto started = std::chrono::steady_clock::now();
+    auto deadline = opt.deadline_ms ? started + std::chrono::milliseconds(opt.deadline_ms)
+                                    : std::chrono::steady_clock::time_point::max();
+    const unsigned int chains = chain_count;
+    std::mt19937 seeds(opt.seed ? opt.seed : std::random_device{}());
+    std::vector<unsigned int> startSeeds(chains), moveSeeds(chains);
+    for (unsigned int c = 0; c < chains; c++) {
+      startSeeds[c] = seeds() | 1u;   // Zero would ask generateAnytime for a random seed.
+      moveSeeds[c] = seeds();
+    }
+    report.requested = opt.n_puzzles;
+    report.chains = chains;
+
+    // Each chain starts from its own run of the anytime search, so the starts are spread
+    // over the board. The search is bounded by the deadline, or by default_job_deadline_ms
+    // without one, since it never ends on a board without layouts; only if it finds
+    // nothing is the lexicographic search tried.
+    auto startDeadline = opt.deadline_ms ? deadline : started + std::chrono::milliseconds(default_job_deadline_ms);
+    RunningOpt first = opt;
+    first.n_puzzles = 1;
+    first.engine = engine_t::dfs;
+    PuzzleStore starts(opt.rows, opt.cols, chains);
+    for (unsigned int c = 0; c < chains; c++) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(startDeadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0) {
+        break;
+      }
+      first.seed = startSeeds[c];
+      first.deadline_ms = static_cast<unsigned int>(left.count());
+      GenerationReport startReport;
+      PuzzleStore one = generateAnytime(first, startReport);
+      if (one.empty()) {
+        break;
+      }
+      starts.push(one[0]);
+    }
+    if (starts.empty() and not opt.deadline_ms) {
+      first.n_puzzles = chains;
+      starts = generate(first);
+    }
+    PuzzleStore store(opt.rows, opt.cols, opt.n_puzzles);
+    if (starts.empty()) {
+      report.deadline_hit = std::chrono::steady_clock::now() >= deadline;
+      report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+      return store;
+    }
+
+    // Chains sample in rounds, each on its own thread, and the samples of a round are
+    // checked in chain order, so the puzzles only depend on the seed (unless the
+    // deadline stops the run).
+    std::vector<MarkovChain> walkers;
+    walkers.reserve(chains);
+    for (unsigned int c = 0; c < chains; c++) {
+      walkers.emplace_back(opt, starts[c % starts.size()], moveSeeds[c]);
+    }
+    Deduplicator pzKeys(opt.dedup_budget_kb * 1024);
+    std::atomic<bool> timedOut{ false };
+    std::vector<ChainTrace> traces(chains);
+    std::vector<CellMask> last(chains);
+    std::vector<std::vector<PuzzleRecord>> batches(chains);
+    std::vector<unsigned long> repeated(chains, 0);
+    std::vector<char> burnt(chains, 0);   // Not vector<bool>: chains set their own flag concurrently.
+    auto walk = [&](unsigned int c, std::size_t k) {
+      MarkovChain &chain = walkers[c];
+      ChainTrace &trace = traces[c];
+      batches[c].clear();
+      if (not burnt[c]) {
+        for (unsigned long m = 0; m < burn_in_moves; m++) {
+          chain.step();
+        }
+        last[c] = chain.occupied();
+        burnt[c] = 1;
+      }
+      for (std::size_t i = 0; i < k; i++) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+          timedOut = true;
+          return;
+        }
+        for (unsigned int m = 0; m < opt.mutate_moves; m++) {
+          chain.step();
+        }
+        CellMask cells = chain.occupied();
+        int kept = 0, total = 0;
+        for (short r = 0; r < opt.rows; r++) {
+          kept += __builtin_popcount(cells[r] & last[c][r]);
+          total += __builtin_popcount(cells[r]);
+        }
+        trace.overlap += double(kept) / total;
+        trace.rows.push_back(battleshipRow(chain.puzzle()));
+        last[c] = cells;
+        batches[c].push_back(PuzzleRecord::fromPuzzle(chain.puzzle()));
+      }
+    };
+    while (store.size() < opt.n_puzzles and not timedOut) {
+      std::vector<unsigned int> running;
+      for (unsigned int c = 0; c < chains; c++) {
+        if (repeated[c] < stall_samples) {
+          running.push_back(c);
+        }
+      }
+      if (running.empty()) {
+        break;
+      }
+      std::size_t k = std::min(batch_samples, (opt.n_puzzles - store.size() + running.size() - 1) / running.size());
+      std::vector<std::thread> workers;
+      for (std::size_t i = 1; i < running.size(); i++) {
+        workers.emplace_back(walk, running[i], k);
+      }
+      walk(running[0], k);
+      for (std::thread &w : workers) {
+        w.join();
+      }
+      for (unsigned int c : running) {
+        for (const PuzzleRecord &rec : batches[c]) {
+          if (store.size() >= opt.n_puzzles or repeated[c] >= stall_samples) {
+            break;
+          }
+          if (pzKeys.insert(rec.canonical())) {
+            store.push(rec);
+            repeated[c] = 0;
+          } else {
+            repeated[c]++;
+          }
+        }
+      }
+    }
+    for (unsigned int c = 0; c < chains; c++) {
+      traces[c].proposed = walkers[c].proposed();
+      traces[c].accepted = walkers[c].accepted();
+    }
+    unsigned int stalled = static_cast<unsigned int>(std::count_if(repeated.begin(), repeated.end(),
+                                                                   [](unsigned long n) { return n >= stall_samples; }));
+
+    // Diagnostics over every chain; the Gelman-Rubin statistic uses as many samples from each.
+    std::size_t samples = 0, common = traces[0].rows.size();
+    double overlap = 0, lagged = 0, weight = 0;
+    for (const ChainTrace &trace : traces) {
+      for (std::size_t k = 0; k < 3; k++) {
+        report.proposed[k] += trace.proposed[k];
+        report.accepted[k] += trace.accepted[k];
+      }
+      samples += trace.rows.size();
+      overlap += trace.overlap;
+      common = std::min(common, trace.rows.size());
+      std::size_t n = trace.rows.size();
+      if (n < 3) {
+        continue;
+      }
+      double mean = 0, var = 0, cov = 0;
+      for (double x : trace.rows) {
+        mean += x / n;
+      }
+      for (std::size_t k = 0; k < n; k++) {
+        var += (trace.rows[k] - mean) * (trace.rows[k] - mean);
+        cov += k > 0 ? (trace.rows[k] - mean) * (trace.rows[k - 1] - mean) : 0;
+      }
+      if (var > 0) {
+        lagged += cov / var * n;
+        weight += n;
+      }
+    }
+    for (std::size_t k = 0; k < 3; k++) {
+      report.moves += report.proposed[k];
+    }
+    report.overlap = samples ? overlap / samples : 0;
+    report.autocorrelation = weight > 0 ? lagged / weight : 0;
+    if (common >= 2) {
+      std::vector<double> means(chains, 0);
+      double within = 0, grand = 0, between = 0;
+      for (unsigned int c = 0; c < chains; c++) {
+        for (std::size_t k = 0; k < common; k++) {
+          means[c] += traces[c].rows[k] / common;
+        }
+        double var = 0;
+        for (std::size_t k = 0; k < common; k++) {
+          var += (traces[c].rows[k] - means[c]) * (traces[c].rows[k] - means[c]) / (common - 1);
+        }
+        within += var / chains;
+        grand += means[c] / chains;
+      }
+      for (double m : means) {
+        between += (m - grand) * (m - grand) / (chains - 1);
+      }
+      if (within > 0) {
+        report.rhat = std::sqrt(((common - 1.0) / common * within + between) / within);
+      }
+    }
+
+    report.found = store.size();
+    report.stalled = stalled;
+    report.deadline_hit = timedOut and store.size() < opt.n_puzzles;
+    report.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return store;
+  }
+
+}
@@ -0,0 +1,372 @@
+#include <iostream> // std::cout, std::endl
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/pool.h"
+#include "include/store.h"
+
+namespace bpg{
+
+  namespace {
+    constexpr char pool_magic[8] = {'B', 'P', 'G', 'P', 'O', 'O', 'L', '\0'};
+    constexpr std::uint32_t pool_version{2};
+
+    /// Slots start on the first page after the header.
+    std::size_t slotsOffset() {
+      std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+      return ((sizeof(PoolHeader) + page - 1) / page) * page;
+    }
+
+    /// Size of a pool file with the given number of slots per dimension.
+    std::size_t poolFileBytes(std::uint32_t capacity) {
+      std::size_t dims = (max_rows - min_rows + 1) * (max_cols - min_cols + 1);
+      return slotsOffset() + dims * std::size_t(capacity) * pool_slot_size;
+    }
+  }
+
+/**
+ * @brief Opens or creates a pool file and maps it into memory.
+ *
+ * A new file is sized for `capacity` slots per dimension. An existing file keeps the
+ * capacity it was created with; its header is read and checked before the file is
+ * mapped, so a truncated file is rejected instead of faulting on access.
+ *
+ * @param fileName The path of the pool file.
+ * @param capacity The number of slots per dimension, used only when the file is created.
+ */
+  PuzzlePool::PuzzlePool(const std::string &fileName, std::uint32_t capacity) {
+    poolFd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (poolFd < 0) {
+      throw std::runtime_error("Error trying to open pool file: " + fileName);
+    }
+    lockFile(true);
+    struct stat st;
+    ::fstat(poolFd, &st);
+    PoolHeader header{};
+    if (st.st_size == 0) {
+      std::memcpy(header.magic, pool_magic, sizeof(pool_magic));
+      header.version = pool_version;
+      header.slotSize = pool_slot_size;
+      header.capacity = capacity;
+      poolBytes = poolFileBytes(capacity);
+      if (::ftruncate(poolFd, static_cast<off_t>(poolBytes)) != 0
+          or ::pwrite(poolFd, &header, sizeof(header), 0) != ssize_t(sizeof(header))) {
+        unlockFile();
+        ::close(poolFd);
+        throw std::runtime_error("Error trying to create pool file: " + fileName);
+      }
+    } else {
+      poolBytes = static_cast<std::size_t>(st.st_size);
+      if (poolBytes < sizeof(PoolHeader)
+          or ::pread(poolFd, &header, sizeof(header), 0) != ssize_t(sizeof(header))
+          or std::memcmp(header.magic, pool_magic, sizeof(pool_magic)) != 0
+          or header.version != pool_version or header.slotSize != pool_slot_size
+          or header.capacity == 0 or poolBytes < poolFileBytes(header.capacity)) {
+        unlockFile();
+        ::close(poolFd);
+        throw std::runtime_error("Invalid pool file: " + fileName);
+      }
+    }
+    unlockFile();
+
+    void *addr = ::mmap(nullptr, poolBytes, PROT_READ | PROT_WRITE, MAP_SHARED, poolFd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(poolFd);
+      throw std::runtime_error("Error trying to map pool file: " + fileName);
+    }
+    poolHeader = static_cast<PoolHeader*>(addr);
+    poolSlots = static_cast<char*>(addr) + slotsOffset();
+  }
+
+/**
+ * @brief Stops the background refill once its pending work is done, flushes the cursors
+ * and unmaps the file.
+ */
+  PuzzlePool::~PuzzlePool() {
+    stopRefill();
+    ::msync(poolHeader, poolBytes, MS_SYNC);
+    ::munmap(poolHeader, poolBytes);
+    ::close(poolFd);
+  }
+
+/**
+ * @brief Returns the index entry of a dimension.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @return A reference to the mapped cursors of that dimension.
+ */
+  PoolIndexEntry& PuzzlePool::entry(unsigned short rows, unsigned short cols) {
+    return poolHeader->index[rows - min_rows][cols - min_cols];
+  }
+
+/**
+ * @brief Returns the slot that holds the puzzle at the given position of a dimension.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @param position The (ever growing) position of the puzzle; the ring wraps it around.
+ * @return A pointer to the first byte of the slot.
+ */
+  char* PuzzlePool::slot(unsigned short rows, unsigned short cols, std::uint64_t position) {
+    std::size_t dim = (rows - min_rows) * (max_cols - min_cols + 1) + (cols - min_cols);
+    std::size_t ring = static_cast<std::size_t>(position % poolHeader->capacity);
+    return poolSlots + (dim * poolHeader->capacity + ring) * pool_slot_size;
+  }
+
+/**
+ * @brief Flushes to disk the slots of a dimension written by a refill.
+ *
+ * Only the pages holding those slots are synced; a range that wraps around the end of
+ * the ring is flushed in two parts.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @param first The position of the first slot written.
+ * @param count The number of slots written.
+ */
+  void PuzzlePool::syncSlots(unsigned short rows, unsigned short cols, std::uint64_t first, std::size_t count) {
+    std::uintptr_t page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    while (count > 0) {
+      std::size_t ring = static_cast<std::size_t>(first % poolHeader->capacity);
+      std::size_t run = std::min<std::size_t>(count, poolHeader->capacity - ring);
+      std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(slot(rows, cols, first));
+      std::uintptr_t end = begin + run * pool_slot_size;
+      begin -= begin % page;
+      ::msync(reinterpret_cast<void*>(begin), end - begin, MS_SYNC);
+      first += run;
+      count -= run;
+    }
+  }
+
+/**
+ * @brief Raises a flag of the refill thread and wakes it up.
+ *
+ * The flag is set under the mutex the thread waits with, so the wakeup cannot fall
+ * between its check of the flags and its wait.
+ *
+ * @param flag refillPending or refillStop.
+ */
+  void PuzzlePool::wakeRefill(std::atomic<bool> &flag) {
+    {
+      std::lock_guard<std::mutex> lock(refillWaitMutex);
+      flag = true;
+    }
+    refillCv.notify_all();
+  }
+
+/**
+ * @brief Locks the pool file so that several processes may share it.
+ *
+ * @param exclusive True for a writer lock, false for a reader lock.
+ */
+  void PuzzlePool::lockFile(bool exclusive) {
+    ::flock(poolFd, exclusive ? LOCK_EX : LOCK_SH);
+  }
+
+/**
+ * @brief Releases the lock taken by lockFile.
+ */
+  void PuzzlePool::unlockFile() {
+    ::flock(poolFd, LOCK_UN);
+  }
+
+/**
+ * @brief Returns how many puzzles of a dimension are ready to be handed out.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @return The number of puzzles produced but not yet consumed.
+ */
+  std::size_t PuzzlePool::available(unsigned short rows, unsigned short cols) {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    lockFile(false);
+    const PoolIndexEntry &e = entry(rows, cols);
+    std::size_t count = static_cast<std::size_t>(e.produced - e.consumed);
+    unlockFile();
+    return count;
+  }
+
+/**
+ * @brief Hands out fresh puzzles of a dimension.
+ *
+ * The consumption cursor is advanced and flushed before the puzzles are returned, so the
+ * same puzzles are never handed out again. If the pool does not hold enough puzzles,
+ * it is refilled first; otherwise, when the refill thread runs, a dimension left at or
+ * below the low watermark is topped up in the background.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @param n The number of puzzles wanted.
+ * @return Up to `n` puzzles; fewer only if the dimension has no more distinct puzzles.
+ */
+  PuzzleStore PuzzlePool::take(unsigned short rows, unsigned short cols, std::size_t n) {
+    if (available(rows, cols) < n) {
+      refill(rows, cols);
+    }
+
+    PuzzleStore store(rows, cols, n);
+    Puzzle pz(cols, rows);
+    std::uint64_t first, last;
+    {
+      std::lock_guard<std::mutex> guard(poolMutex);
+      lockFile(true);
+      PoolIndexEntry &e = entry(rows, cols);
+      first = e.consumed;
+      last = std::min<std::uint64_t>(e.produced, e.consumed + n);
+      for (std::uint64_t pos = first; pos < last; pos++) {
+        pz.puzzleArmada = std::string(slot(rows, cols, pos));
+        if (Generator::parseArmada(pz)) {
+          store.push(pz);
+        }
+      }
+      e.consumed = last;
+      ::msync(poolHeader, sizeof(PoolHeader), MS_SYNC);
+      unlockFile();
+    }
+
+    if (refillThread.joinable() and available(rows, cols) <= refillLow) {
+      wakeRefill(refillPending);
+    }
+    return store;
+  }
+
+/**
+ * @brief Tops up the ring of a dimension with newly generated puzzles.
+ *
+ * Generator::generateAfter resumes the search right after the last puzzle written, so
+ * the new puzzles have never been stored before and the work done is proportional to
+ * the puzzles added. Generation happens without holding the file lock; the batch is
+ * dropped if another process refilled the dimension meanwhile.
+ *
+ * @param rows The number of rows of the puzzles.
+ * @param cols The number of columns of the puzzles.
+ * @return The number of puzzles added to the pool.
+ */
+  std::size_t PuzzlePool::refill(unsigned short rows, unsigned short cols) {
+    std::lock_guard<std::mutex> serial(refillMutex);
+    PoolIndexEntry start;
+    {
+      std::lock_guard<std::mutex> guard(poolMutex);
+      lockFile(false);
+      start = entry(rows, cols);
+      unlockFile();
+    }
+    std::uint64_t target = start.consumed + poolHeader->capacity;
+    if (start.exhausted or target <= start.produced) {
+      return 0;
+    }
+
+    std::size_t wanted = static_cast<std::size_t>(target - start.produced);
+    auto puzzles = Generator::generateAfter(rows, cols, start.produced > 0 ? &start.last : nullptr, wanted);
+
+    std::lock_guard<std::mutex> guard(poolMutex);
+    lockFile(true);
+    PoolIndexEntry &e = entry(rows, cols);
+    if (e.produced != start.produced) {
+      unlockFile();
+      return 0;
+    }
+    Puzzle pz(cols, rows);
+    for (std::size_t i = 0; i < puzzles.size(); i++) {
+      puzzles.materialize(i, pz);
+      char *dst = slot(rows, cols, e.produced + i);
+      std::memset(dst, 0, pool_slot_size);
+      std::memcpy(dst, pz.puzzleArmada.data(), std::min<std::size_t>(pz.puzzleArmada.size(), pool_slot_size - 1));
+    }
+    syncSlots(rows, cols, e.produced, puzzles.size());
+    if (not puzzles.empty()) {
+      e.last = puzzles[puzzles.size() - 1];
+    }
+    e.produced += puzzles.size();
+    e.exhausted = puzzles.size() < wanted ? 1 : 0;
+    ::msync(poolHeader, sizeof(PoolHeader), MS_SYNC);
+    unlockFile();
+    return puzzles.size();
+  }
+
+/**
+ * @brief Pre-generates every dimension up to the pool capacity.
+ */
+  void PuzzlePool::fillAll() {
+    for (unsigned short r = min_rows; r <= max_rows; r++) {
+      for (unsigned short c = min_cols; c <= max_cols; c++) {
+        std::size_t added = refill(r, c);
+        std::cout << ">>> Pool " << r << "x" << c << ": +" << added
+                  << " (" << available(r, c) << " available)" << std::endl;
+      }
+    }
+  }
+
+/**
+ * @brief Starts a background thread that refills dimensions running low.
+ *
+ * @param lowWatermark A dimension with this many puzzles (or fewer) left is refilled.
+ */
+  void PuzzlePool::startRefill(std::uint32_t lowWatermark) {
+    if (refillThread.joinable()) {
+      return;
+    }
+    refillLow = lowWatermark;
+    refillStop = false;
+    refillThread = std::thread(&PuzzlePool::refillLoop, this);
+  }
+
+/**
+ * @brief Stops the background refill thread.
+ *
+ * A top-up asked for by take() is carried out first, so the puzzles handed out by this
+ * process are replaced before it ends.
+ */
+  void PuzzlePool::stopRefill() {
+    if (not refillThread.joinable()) {
+      return;
+    }
+    wakeRefill(refillStop);
+    refillThread.join();
+  }
+
+/**
+ * @brief Body of the refill thread.
+ *
+ * Wakes up when take() leaves a dimension at or below the low watermark (or once a
+ * second) and refills every dimension that has been touched and is running low.
+ */
+  void PuzzlePool::refillLoop() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(refillWaitMutex);
+        refillCv.wait_for(lock, std::chrono::seconds(1), [this] { return refillStop or refillPending; });
+      }
+      bool pending = refillPending.exchange(false);
+      if (refillStop and not pending) {
+        return;
+      }
+      for (unsigned short r = min_rows; r <= max_rows; r++) {
+        for (unsigned short c = min_cols; c <= max_cols; c++) {
+          bool touched;
+          {
+            std::lock_guard<std::mutex> guard(poolMutex);
+            touched = entry(r, c).consumed > 0;
+          }
+          if (touched and available(r, c) <= refillLow) {
+            refill(r, c);
+          }
+        }
+      }
+    }
+  }
+
+}
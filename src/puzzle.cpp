@@ -1,6 +1,7 @@
 #include <iostream> // std::cout, std::endl
 #include <vector>
 #include <algorithm>
+#include <cstdlib>  // std::abs
 
 #include "include/bpg.h"
 #include "include/common.h"
@@ -109,8 +110,8 @@ namespace bpg{
  * @brief Adds a ship to the puzzle board.
  * 
  * This function attempts to add the given ship to the puzzle board.
- * It checks if the ship's shadow cells are empty and if the ship's body cells are all water.
- * If both conditions are met, the ship is added to the puzzle board.
+ * It checks if the ship's shadow cells are empty and if the ship's body cells are all water
+ * and not forbidden. If both conditions are met, the ship is added to the puzzle board.
  * 
  * @param ship The ship to be added to the puzzle board.
  * @return True if the ship was successfully added, false otherwise.
@@ -126,7 +127,7 @@ namespace bpg{
       auto ship_body_cells = getShipBody(ship);
       if (ship_body_cells.empty() or int(ship_body_cells.size()) != ship.shipSize
           or not std::all_of(ship_body_cells.cbegin(), ship_body_cells.cend(), [&](const Cell& c) {
-              return this->isLocationWater(c);
+              return this->isLocationWater(c) and not (puzzleForbidden[c.row] & (1u << c.col));
             })) {
         return false;
       }
@@ -158,4 +159,72 @@ namespace bpg{
     return true;
   }
 
-};
\ No newline at end of file
+/**
+ * @brief Sets the cells that some ship must cover.
+ *
+ * @param cells The required cells; with none, canCoverRequired() skips every check.
+ */
+  void Puzzle::setRequired(const CellMask &cells) {
+    puzzleRequired = cells;
+    puzzleHasRequired = std::any_of(cells.cbegin(), cells.cend(), [](std::uint16_t row) { return row != 0; });
+  }
+
+/**
+ * @brief Checks whether the required cells can still be covered.
+ *
+ * A required cell that is not covered yet must be under the body of some ship still to be
+ * placed, in a position that addShip accepts on the current board. Each candidate position
+ * is tried with addShip and undone with removeShip. Besides, cells too far apart to share a
+ * ship need a ship each: when a set of such cells is larger than the number of ships left,
+ * they cannot all be covered.
+ *
+ * @param next The index of the first ship not placed yet; the ships before it are on the board.
+ * @return False if the required cells are out of reach of the ships left.
+ */
+  bool Puzzle::reachesRequired(std::size_t next) {
+    int longest = 0;
+    for (std::size_t i = next; i < puzzleShips.size(); i++) {
+      longest = std::max(longest, puzzleShips[i].shipSize);
+    }
+    std::vector<Cell> apart;   // Uncovered required cells, no two of them on a single ship.
+    for (short row = 0; row < puzzleRows; row++) {
+      for (unsigned bits = puzzleRequired[row]; bits; bits &= bits - 1) {
+        short col = short(__builtin_ctz(bits));
+        if (not isLocationWater(Cell(row, col))) {
+          continue;
+        }
+        bool reachable = false;
+        for (std::size_t i = next; i < puzzleShips.size() and not reachable; i++) {
+          if (i > next and puzzleShips[i].shipType == puzzleShips[i - 1].shipType) {
+            continue;
+          }
+          Ship ship = puzzleShips[i];
+          bool submarine = ship.shipType == cell_t::submarine;
+          for (int v = 0; v < (submarine ? 1 : 2) and not reachable; v++) {
+            if (not submarine) {
+              ship.shipOrientation = v ? Ship::orientation::V : Ship::orientation::H;
+            }
+            for (int k = 0; k < ship.shipSize and not reachable; k++) {
+              ship.shipHeadCell = v ? Cell(row - k, col) : Cell(row, col - k);
+              if (isInsideBoard(ship.shipHeadCell) and addShip(ship)) {
+                removeShip(ship);
+                reachable = true;
+              }
+            }
+          }
+        }
+        if (not reachable) {
+          return false;
+        }
+        bool shares = std::any_of(apart.cbegin(), apart.cend(), [&](const Cell &c) {
+          return (c.row == row and std::abs(c.col - col) < longest) or (c.col == col and std::abs(c.row - row) < longest);
+        });
+        if (not shares) {
+          apart.emplace_back(row, col);
+        }
+      }
+    }
+    return apart.size() <= puzzleShips.size() - next;
+  }
+
+};
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstring>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/store.h"
+
+namespace bpg{
+
+/**
+ * @brief Packs the ships of a puzzle into a record.
+ *
+ * @param pz The puzzle whose ships are packed.
+ * @return The record describing the puzzle's armada.
+ */
+  PuzzleRecord PuzzleRecord::fromPuzzle(const Puzzle &pz) {
+    PuzzleRecord rec;
+    for (std::size_t i = 0; i < armada_size; i++) {
+      const Ship &ship = pz.puzzleShips[i];
+      rec.heads[i] = static_cast<std::uint8_t>((ship.shipHeadCell.row << 4) | ship.shipHeadCell.col);
+      if (ship.shipType != cell_t::submarine and ship.shipOrientation == Ship::orientation::V) {
+        rec.vertical |= static_cast<std::uint16_t>(1u << i);
+      }
+    }
+    return rec;
+  }
+
+/**
+ * @brief Places the ships of a record on a puzzle.
+ *
+ * The puzzle board is cleared and every ship is added again, so the puzzle must have
+ * the dimensions the record was generated with.
+ *
+ * @param pz The puzzle that receives the ships.
+ */
+  void PuzzleRecord::toPuzzle(Puzzle &pz) const {
+    pz.clear();
+    for (std::size_t i = 0; i < armada_size; i++) {
+      Ship &ship = pz.puzzleShips[i];
+      ship.shipHeadCell = Cell(heads[i] >> 4, heads[i] & 0x0F);
+      if (ship.shipType != cell_t::submarine) {
+        ship.shipOrientation = (vertical & (1u << i)) ? Ship::orientation::V : Ship::orientation::H;
+      }
+      ship.shipPlaced = pz.addShip(ship);
+    }
+  }
+
+/**
+ * @brief Returns the canonical form of the record.
+ *
+ * Ships of the same type are interchangeable, so two records describe the same board
+ * exactly when their canonical forms are equal. The canonical form sorts the ships
+ * within each type group.
+ *
+ * @return The canonical record.
+ */
+  PuzzleRecord PuzzleRecord::canonical() const {
+    // Ship groups in the armada order: B | D D | C C C | S S S S.
+    static constexpr std::size_t groups[] = { 0, 1, 3, 6, armada_size };
+    PuzzleRecord out;
+    for (std::size_t g = 0; g + 1 < std::size(groups); g++) {
+      std::uint16_t keys[armada_size];
+      std::size_t n = 0;
+      for (std::size_t i = groups[g]; i < groups[g + 1]; i++) {
+        keys[n++] = static_cast<std::uint16_t>((heads[i] << 1) | ((vertical >> i) & 1u));
+      }
+      std::sort(keys, keys + n);
+      for (std::size_t k = 0; k < n; k++) {
+        std::size_t i = groups[g] + k;
+        out.heads[i] = static_cast<std::uint8_t>(keys[k] >> 1);
+        if (keys[k] & 1u) {
+          out.vertical |= static_cast<std::uint16_t>(1u << i);
+        }
+      }
+    }
+    return out;
+  }
+
+/**
+ * @brief Compares two records lexicographically.
+ *
+ * @param rhs The record to compare with.
+ * @return True if this record comes first.
+ */
+  bool PuzzleRecord::operator<(const PuzzleRecord &rhs) const {
+    int cmp = std::memcmp(heads, rhs.heads, armada_size);
+    return cmp < 0 or (cmp == 0 and vertical < rhs.vertical);
+  }
+
+/**
+ * @brief Checks if two records describe the same ship placements.
+ *
+ * @param rhs The record to compare with.
+ * @return True if both records are equal.
+ */
+  bool PuzzleRecord::operator==(const PuzzleRecord &rhs) const {
+    return std::memcmp(heads, rhs.heads, armada_size) == 0 and vertical == rhs.vertical;
+  }
+
+/**
+ * @brief Builds the full puzzle of a stored record.
+ *
+ * The board, the key and the armada string of `pz` are rebuilt in place, so a single
+ * puzzle object can be reused to walk the whole store.
+ *
+ * @param i The index of the record.
+ * @param pz The puzzle that receives the board, key and armada.
+ */
+  void PuzzleStore::materialize(std::size_t i, Puzzle &pz) const {
+    storeRecords[i].toPuzzle(pz);
+    Generator::generatePuzzleKey(pz);
+    Generator::generateArmada(pz);
+  }
+
+}
@@ -0,0 +1,271 @@
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BPG_HAS_AVX2_PATH 1
+#include <immintrin.h>
+#endif
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/store.h"
+#include "include/validator.h"
+
+namespace bpg{
+
+  namespace {
+    /// Ship types in the armada order used by Puzzle and PuzzleRecord.
+    constexpr cell_t armada_types[armada_size] = {
+      cell_t::battleship, cell_t::destroyer, cell_t::destroyer,
+      cell_t::cruiser, cell_t::cruiser, cell_t::cruiser,
+      cell_t::submarine, cell_t::submarine, cell_t::submarine, cell_t::submarine
+    };
+
+    constexpr std::size_t n_heads{ max_rows * max_cols };
+
+    /// Sets the bits of the given cells in a mask.
+    void setCells(BoardMask &mask, const std::list<Cell> &cells) {
+      for (const Cell &c : cells) {
+        mask.rows[c.row] = static_cast<std::uint16_t>(mask.rows[c.row] | (1u << c.col));
+      }
+    }
+  }
+
+/**
+ * @brief Converts a layout error to a short description.
+ *
+ * @param error The error to describe.
+ * @return The description of the error.
+ */
+  std::string errorToString(layout_error error) {
+    switch (error) {
+      case layout_error::none: return "ok";
+      case layout_error::out_of_bounds: return "ship out of bounds";
+      case layout_error::overlap: return "ships overlap";
+      case layout_error::touching: return "ships touch each other";
+      case layout_error::bad_armada: return "bad armada";
+    }
+    return "unknown";
+  }
+
+/**
+ * @brief Builds the body and shadow masks of every ship placement.
+ *
+ * The masks are produced by Puzzle::getShipBody and Puzzle::getShipShadow, so the
+ * validator follows exactly the same rules as Puzzle::addShip.
+ *
+ * @param r The number of rows of the boards.
+ * @param c The number of columns of the boards.
+ */
+  BatchValidator::BatchValidator(int r, int c)
+    : validatorRows(r), validatorCols(c), validatorPlacements(4 * 2 * n_heads) {
+    Puzzle pz(c, r);
+    for (int t = 1; t <= 4; t++) {
+      for (int v = 0; v < 2; v++) {
+        for (int row = 0; row < max_rows; row++) {
+          for (int col = 0; col < max_cols; col++) {
+            Ship ship(static_cast<cell_t>(t), Cell(row, col), v ? Ship::orientation::V : Ship::orientation::H);
+            auto body = pz.getShipBody(ship);
+            Placement &p = validatorPlacements[((t - 1) * 2 + v) * n_heads + row * max_cols + col];
+            p.inside = row < r and col < c and int(body.size()) == ship.shipSize;
+            setCells(p.body, body);
+            setCells(p.shadow, pz.getShipShadow(ship));
+          }
+        }
+      }
+    }
+  }
+
+/**
+ * @brief Returns the masks of a ship placement.
+ *
+ * @param type The ship type.
+ * @param vertical True if the ship is vertical.
+ * @param row The head row.
+ * @param col The head column.
+ * @return The placement masks.
+ */
+  const BatchValidator::Placement& BatchValidator::placement(cell_t type, bool vertical, int row, int col) const {
+    return validatorPlacements[((int(type) - 1) * 2 + (vertical ? 1 : 0)) * n_heads + row * max_cols + col];
+  }
+
+/**
+ * @brief Checks if the CPU running the program supports AVX2.
+ *
+ * @return True if the AVX2 path can be used.
+ */
+  bool BatchValidator::hasAvx2() {
+#ifdef BPG_HAS_AVX2_PATH
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  }
+
+/**
+ * @brief Checks a layout with portable 64-bit bitboard operations.
+ *
+ * Ships are added one at a time; a ship is rejected if its body hits the bodies
+ * (overlap) or the shadows (touching) of the ships already added.
+ *
+ * @param rec The layout to check.
+ * @return The first rule broken by the layout, or layout_error::none.
+ */
+  layout_error BatchValidator::checkBitboard(const PuzzleRecord &rec) const {
+    std::uint64_t occupied[4] = {0, 0, 0, 0};
+    std::uint64_t shadow[4] = {0, 0, 0, 0};
+    for (std::size_t i = 0; i < armada_size; i++) {
+      const Placement &p = placement(armada_types[i], (rec.vertical >> i) & 1u, rec.heads[i] >> 4, rec.heads[i] & 0x0F);
+      if (not p.inside) {
+        return layout_error::out_of_bounds;
+      }
+      std::uint64_t body[4], margin[4];
+      std::memcpy(body, p.body.rows, sizeof(body));
+      std::memcpy(margin, p.shadow.rows, sizeof(margin));
+      std::uint64_t hitBody = 0, hitShadow = 0;
+      for (int w = 0; w < 4; w++) {
+        hitBody |= body[w] & occupied[w];
+        hitShadow |= body[w] & shadow[w];
+      }
+      if (hitBody) {
+        return layout_error::overlap;
+      }
+      if (hitShadow) {
+        return layout_error::touching;
+      }
+      for (int w = 0; w < 4; w++) {
+        occupied[w] |= body[w];
+        shadow[w] |= margin[w];
+      }
+    }
+    return layout_error::none;
+  }
+
+/**
+ * @brief Checks a layout with AVX2, holding a whole 16x16 board in one register.
+ *
+ * Same rules as checkBitboard.
+ *
+ * @param rec The layout to check.
+ * @return The first rule broken by the layout, or layout_error::none.
+ */
+#ifdef BPG_HAS_AVX2_PATH
+  __attribute__((target("avx2")))
+  layout_error BatchValidator::checkAvx2(const PuzzleRecord &rec) const {
+    __m256i occupied = _mm256_setzero_si256();
+    __m256i shadow = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < armada_size; i++) {
+      const Placement &p = placement(armada_types[i], (rec.vertical >> i) & 1u, rec.heads[i] >> 4, rec.heads[i] & 0x0F);
+      if (not p.inside) {
+        return layout_error::out_of_bounds;
+      }
+      __m256i body = _mm256_load_si256(reinterpret_cast<const __m256i*>(p.body.rows));
+      if (not _mm256_testz_si256(body, occupied)) {
+        return layout_error::overlap;
+      }
+      if (not _mm256_testz_si256(body, shadow)) {
+        return layout_error::touching;
+      }
+      occupied = _mm256_or_si256(occupied, body);
+      shadow = _mm256_or_si256(shadow, _mm256_load_si256(reinterpret_cast<const __m256i*>(p.shadow.rows)));
+    }
+    return layout_error::none;
+  }
+#else
+  layout_error BatchValidator::checkAvx2(const PuzzleRecord &rec) const {
+    return checkBitboard(rec);
+  }
+#endif
+
+/**
+ * @brief Validates every layout of this validator's dimension.
+ *
+ * Layouts of other dimensions, or already marked with an error, are left untouched.
+ *
+ * @param layouts The layouts to validate; their error field receives the result.
+ * @param path How the layouts are checked.
+ */
+  void BatchValidator::validate(std::vector<ArmadaLayout> &layouts, validator_path path) const {
+    if (path == validator_path::scalar) {
+      validateScalar(layouts);
+      return;
+    }
+    bool avx2 = path == validator_path::avx2 and hasAvx2();
+    for (ArmadaLayout &layout : layouts) {
+      if (layout.error != layout_error::none or layout.rows != validatorRows or layout.cols != validatorCols) {
+        continue;
+      }
+      layout.error = avx2 ? checkAvx2(layout.record) : checkBitboard(layout.record);
+    }
+  }
+
+/**
+ * @brief Validates layouts by placing their ships one by one with Puzzle::addShip.
+ *
+ * This is the reference (and slow) path the bitboard validator is measured against.
+ *
+ * @param layouts The layouts to validate; their error field receives the result.
+ */
+  void BatchValidator::validateScalar(std::vector<ArmadaLayout> &layouts) const {
+    Puzzle pz(validatorCols, validatorRows);
+    for (ArmadaLayout &layout : layouts) {
+      if (layout.error != layout_error::none or layout.rows != validatorRows or layout.cols != validatorCols) {
+        continue;
+      }
+      pz.clear();
+      for (std::size_t i = 0; i < armada_size; i++) {
+        Ship ship(armada_types[i], Cell(layout.record.heads[i] >> 4, layout.record.heads[i] & 0x0F),
+                  ((layout.record.vertical >> i) & 1u) ? Ship::orientation::V : Ship::orientation::H);
+        auto body = pz.getShipBody(ship);
+        if (not pz.isInsideBoard(ship.shipHeadCell) or int(body.size()) != ship.shipSize) {
+          layout.error = layout_error::out_of_bounds;
+          break;
+        }
+        bool free = true;
+        for (const Cell &c : body) {
+          free = free and pz.isLocationWater(c);
+        }
+        if (not free) {
+          layout.error = layout_error::overlap;
+          break;
+        }
+        if (not pz.addShip(ship)) {
+          layout.error = layout_error::touching;
+          break;
+        }
+      }
+    }
+  }
+
+/**
+ * @brief Validates layouts of any dimensions.
+ *
+ * One BatchValidator is built for each dimension found among the layouts. Building the
+ * placement masks costs far more than checking a layout, so validators are cached.
+ *
+ * @param layouts The layouts to validate; their error field receives the result.
+ * @param path How the layouts are checked.
+ */
+  void validateLayouts(std::vector<ArmadaLayout> &layouts, validator_path path) {
+    std::set<std::pair<short, short>> dims;
+    for (const ArmadaLayout &layout : layouts) {
+      if (layout.error == layout_error::none) {
+        dims.insert({layout.rows, layout.cols});
+      }
+    }
+    static std::map<std::pair<short, short>, BatchValidator> cache;
+    static std::mutex cacheMutex;
+    for (const auto &[r, c] : dims) {
+      const BatchValidator *validator;
+      {
+        std::lock_guard<std::mutex> guard(cacheMutex);
+        validator = &cache.try_emplace({r, c}, r, c).first->second;
+      }
+      validator->validate(layouts, path);
+    }
+  }
+
+}
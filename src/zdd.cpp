@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/bpg.h"
+#include "include/common.h"
+#include "include/store.h"
+#include "include/zdd.h"
+
+namespace bpg{
+
+  namespace {
+    constexpr char zdd_magic[8] = {'B', 'P', 'G', 'Z', 'D', 'D', '\0', '\0'};
+    constexpr std::uint32_t zdd_version{2};
+    constexpr std::uint32_t zdd_terminal{ std::numeric_limits<std::uint32_t>::max() };
+
+    /// Placement options of a head cell, in variable order.
+    constexpr int n_options{ 7 };
+    constexpr int option_type[n_options] = { 0, 0, 1, 1, 2, 2, 3 };    // B B D D C C S
+    constexpr bool option_vertical[n_options] = { false, true, false, true, false, true, false };
+    constexpr int type_max[4] = { 1, 2, 3, 4 };
+    constexpr int type_size[4] = { 4, 3, 2, 1 };
+    constexpr std::size_t type_first_slot[4] = { 0, 1, 3, 6 };
+    constexpr std::uint64_t complete_armada = 1 | (2 << 3) | (3 << 6) | (4 << 9);
+
+    /// Fixed header of a ZDD file; the nodes follow it.
+    struct ZddHeader {
+      char magic[8];
+      std::uint32_t version;
+      std::uint16_t rows;
+      std::uint16_t cols;
+      std::uint64_t nodeCount;
+      std::uint32_t root;
+      std::uint32_t transposed;   // 1 if the nodes describe the transposed board.
+    };
+
+    /// Bits of a State holding the ships used so far, 3 bits per type, above the blocked cells.
+    constexpr int used_shift{ 52 };
+    constexpr std::uint64_t window_mask{ (1ull << used_shift) - 1 };
+
+    /// The widest board whose window, 4 rows and 2 cells past the head, fits below used_shift.
+    constexpr int max_width{ 12 };
+
+    /// Blocked cells from the current head cell on (bit 0 is the current cell), then the ships used.
+    using State = std::uint64_t;
+    struct StateHash {
+      std::size_t operator()(State s) const {
+        s ^= s >> 29;
+        s *= 0xBF58476D1CE4E5B9ull;
+        return std::size_t(s ^ (s >> 32));
+      }
+    };
+
+    /// Number of ships of type `t` used in a state.
+    int usedOf(State s, int t) {
+      return int((s >> (used_shift + 3 * t)) & 7);
+    }
+
+    /// A placement option of a head cell; masks are relative to the head cell.
+    struct Option {
+      bool inside = false;
+      std::uint64_t body = 0;
+      std::uint64_t shadow = 0;
+    };
+
+    struct NodeKey {
+      std::uint32_t var, lo, hi;
+      bool operator==(const NodeKey &rhs) const { return var == rhs.var and lo == rhs.lo and hi == rhs.hi; }
+    };
+    struct NodeKeyHash {
+      std::size_t operator()(const NodeKey &k) const {
+        return (std::size_t(k.var) * 0x9E3779B97F4A7C15ull) ^ (std::size_t(k.lo) << 21) ^ (std::size_t(k.hi) * 0xC2B2AE3D27D4EB4Full);
+      }
+    };
+
+    /// Builds the record of a set of placement variables (sorted, so heads come in order).
+    PuzzleRecord recordOf(const std::vector<std::uint32_t> &vars, short cols) {
+      PuzzleRecord rec;
+      std::size_t next[4] = { type_first_slot[0], type_first_slot[1], type_first_slot[2], type_first_slot[3] };
+      for (std::uint32_t var : vars) {
+        int head = int(var / n_options), o = int(var % n_options);
+        std::size_t slot = next[option_type[o]]++;
+        rec.heads[slot] = static_cast<std::uint8_t>(((head / cols) << 4) | (head % cols));
+        if (option_vertical[o]) {
+          rec.vertical |= static_cast<std::uint16_t>(1u << slot);
+        }
+      }
+      return rec;
+    }
+
+    /// Mirrors a layout along the main diagonal: heads swap row and column, H and V swap.
+    PuzzleRecord transposed(const PuzzleRecord &rec) {
+      PuzzleRecord out;
+      for (std::size_t i = 0; i < armada_size; i++) {
+        out.heads[i] = static_cast<std::uint8_t>((rec.heads[i] << 4) | (rec.heads[i] >> 4));
+      }
+      out.vertical = static_cast<std::uint16_t>(rec.vertical ^ ((1u << type_first_slot[3]) - 1));
+      return out.canonical();
+    }
+  }
+
+/**
+ * @brief Converts a count to its decimal representation.
+ *
+ * @param value The count to convert.
+ * @return The decimal digits of the count.
+ */
+  std::string countToString(zdd_count value) {
+    if (value == 0) {
+      return "0";
+    }
+    std::string digits;
+    while (value > 0) {
+      digits += char('0' + int(value % 10));
+      value /= 10;
+    }
+    return std::string(digits.rbegin(), digits.rend());
+  }
+
+/**
+ * @brief Unmaps or frees the nodes.
+ */
+  LayoutZdd::~LayoutZdd() {
+    release();
+  }
+
+/**
+ * @brief Drops the current diagram, owned or mapped.
+ */
+  void LayoutZdd::release() {
+    if (zddMap != nullptr) {
+      ::munmap(zddMap, zddMapBytes);
+      zddMap = nullptr;
+    }
+    zddOwned.clear();
+    zddOwned.shrink_to_fit();
+    zddNodes = nullptr;
+    zddSize = 0;
+    zddRoot = 0;
+    zddTransposed = false;
+  }
+
+/**
+ * @brief Tells whether the diagram of a dimension fits the build budget.
+ *
+ * The states of a level cover the few rows a vertical ship reaches past its head, so
+ * their number grows with the width of the board and only linearly with its height.
+ * Wide boards are built transposed. With `zdd_max_states` (about 1 GB while building),
+ * every board whose narrower side is at most 10 fits (16x10 needs about 4.6e7 states),
+ * and 11x11 is the only 11-wide board that does.
+ *
+ * @param r The number of rows of the board.
+ * @param c The number of columns of the board.
+ * @return True if build() is expected to succeed.
+ */
+  bool LayoutZdd::supported(int r, int c) {
+    return std::min(r, c) <= 10 or (r == 11 and c == 11);
+  }
+
+/**
+ * @brief Builds the diagram of every valid layout of a dimension.
+ *
+ * Boards wider than they are tall are built transposed, which keeps the states small;
+ * unrank() and rank() transpose the layouts back and forth. Head cells are visited in
+ * row-major order. A state holds the cells already blocked
+ * (bodies and shadows of the ships placed so far) from the current cell on, and how
+ * many ships of each type were used. States are enumerated top-down, level by level,
+ * then turned into reduced ZDD nodes bottom-up. Body and shadow masks come from
+ * Puzzle::getShipBody and Puzzle::getShipShadow.
+ *
+ * The number of states grows quickly with the width of the board. A state keeps the
+ * window of the next 52 cells in one word, so boards whose narrower side is above 12 are
+ * refused at once, and the build gives up as soon as it would need more than `maxStates`.
+ *
+ * @param r The number of rows of the board.
+ * @param c The number of columns of the board.
+ * @param maxStates The largest number of states the build may hold.
+ * @return True if the diagram was built, false if it exceeded the budget.
+ */
+  bool LayoutZdd::build(int r, int c, std::size_t maxStates) {
+    release();
+    zddRows = r;
+    zddCols = c;
+    if (std::min(r, c) > max_width) {
+      return false;
+    }
+    zddTransposed = c > r;
+    if (zddTransposed) {
+      std::swap(r, c);
+    }
+    const int cells = r * c;
+
+    Puzzle pz(c, r);
+    std::vector<Option> options(std::size_t(cells) * n_options);
+    for (int p = 0; p < cells; p++) {
+      for (int o = 0; o < n_options; o++) {
+        Ship ship(static_cast<cell_t>(option_type[o] + 1), Cell(p / c, p % c),
+                  option_vertical[o] ? Ship::orientation::V : Ship::orientation::H);
+        Option &opt = options[std::size_t(p) * n_options + o];
+        auto body = pz.getShipBody(ship);
+        opt.inside = int(body.size()) == ship.shipSize;
+        for (const Cell &cell : body) {
+          opt.body |= 1ull << (cell.row * c + cell.col - p);
+        }
+        for (const Cell &cell : pz.getShipShadow(ship)) {
+          int offset = cell.row * c + cell.col - p;
+          if (offset >= 0) {
+            opt.shadow |= 1ull << offset;
+          }
+        }
+      }
+    }
+
+    // Moves from cell p to cell p + 1, placing option o (or nothing if o < 0).
+    auto expand = [&](int p, int o, State s, State &child) {
+      child = s;
+      if (o >= 0) {
+        const Option &opt = options[std::size_t(p) * n_options + o];
+        int t = option_type[o];
+        if (not opt.inside or usedOf(s, t) >= type_max[t] or (s & opt.body)) {
+          return false;
+        }
+        child = (child | opt.shadow) + (1ull << (used_shift + 3 * t));
+      }
+      // Every ship left, with its right and bottom margin, must fit in the rows left.
+      int need = 0;
+      for (int t = 0; t < 4; t++) {
+        need += (type_max[t] - usedOf(child, t)) * 2 * (type_size[t] + 1);
+      }
+      if (need > (r - (p + 1) / c + 1) * (c + 1)) {
+        return false;
+      }
+      child = (child & ~window_mask) | ((child & window_mask) >> 1);
+      return true;
+    };
+
+    std::vector<std::vector<State>> levels(std::size_t(cells) + 1);
+    levels[0].push_back(State{});
+    std::size_t total = 1;
+    for (int p = 0; p < cells; p++) {
+      std::unordered_set<State, StateHash> next;
+      next.reserve(levels[p].size() * 2);
+      for (State s : levels[p]) {
+        State child;
+        for (int o = -1; o < n_options; o++) {
+          if (expand(p, o, s, child)) {
+            next.insert(child);
+          }
+        }
+      }
+      levels[p + 1].assign(next.begin(), next.end());
+      std::sort(levels[p + 1].begin(), levels[p + 1].end());
+      total += levels[p + 1].size();
+      if (total > maxStates) {
+        return false;
+      }
+    }
+
+    zddOwned.reserve(total / 2);
+    zddOwned.push_back(ZddNode{ zdd_terminal, 0, 0, 0, 0, 0 });   // empty family
+    zddOwned.push_back(ZddNode{ zdd_terminal, 1, 1, 0, 1, 0 });   // family of the empty set
+    // Nodes of a level all test variables of that level, so the unique table of a level
+    // never matches the nodes of another one and is dropped once the level is done.
+    std::unordered_map<NodeKey, std::uint32_t, NodeKeyHash> unique;
+    auto make = [&](std::uint32_t var, std::uint32_t lo, std::uint32_t hi) {
+      if (hi == 0) {
+        return lo;
+      }
+      NodeKey key{ var, lo, hi };
+      auto it = unique.find(key);
+      if (it != unique.end()) {
+        return it->second;
+      }
+      zdd_count n = zddOwned[lo].count() + zddOwned[hi].count();
+      std::uint32_t id = static_cast<std::uint32_t>(zddOwned.size());
+      zddOwned.push_back(ZddNode{ var, lo, hi, 0, std::uint64_t(n), std::uint64_t(n >> 64) });
+      unique.emplace(key, id);
+      return id;
+    };
+
+    std::vector<std::uint32_t> ids(levels[cells].size());
+    for (std::size_t i = 0; i < ids.size(); i++) {
+      ids[i] = (levels[cells][i] >> used_shift) == complete_armada ? 1 : 0;
+    }
+    for (int p = cells - 1; p >= 0; p--) {
+      const std::vector<State> &below = levels[p + 1];
+      auto lookup = [&](State s) -> std::uint32_t {
+        auto it = std::lower_bound(below.begin(), below.end(), s);
+        return (it != below.end() and *it == s) ? ids[it - below.begin()] : 0;
+      };
+      unique.clear();
+      std::vector<std::uint32_t> current(levels[p].size());
+      for (std::size_t i = 0; i < levels[p].size(); i++) {
+        State child;
+        std::uint32_t node = expand(p, -1, levels[p][i], child) ? lookup(child) : 0;
+        for (int o = n_options - 1; o >= 0; o--) {
+          if (expand(p, o, levels[p][i], child)) {
+            node = make(std::uint32_t(p * n_options + o), node, lookup(child));
+          }
+        }
+        current[i] = node;
+      }
+      ids.swap(current);
+      levels[p + 1].clear();
+      levels[p + 1].shrink_to_fit();
+    }
+
+    zddRoot = ids[0];
+    zddNodes = zddOwned.data();
+    zddSize = zddOwned.size();
+    return true;
+  }
+
+/**
+ * @brief Writes the diagram to a file that open() can map.
+ *
+ * @param fileName The name of the file.
+ * @return True if the file was written, false otherwise.
+ */
+  bool LayoutZdd::save(const std::string &fileName) const {
+    std::ofstream arquivo(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!arquivo.is_open()) {
+      return false;
+    }
+    ZddHeader header{};
+    std::memcpy(header.magic, zdd_magic, sizeof(zdd_magic));
+    header.version = zdd_version;
+    header.rows = static_cast<std::uint16_t>(zddRows);
+    header.cols = static_cast<std::uint16_t>(zddCols);
+    header.nodeCount = zddSize;
+    header.root = zddRoot;
+    header.transposed = zddTransposed ? 1 : 0;
+    arquivo.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    arquivo.write(reinterpret_cast<const char*>(zddNodes), std::streamsize(zddSize * sizeof(ZddNode)));
+    return bool(arquivo);
+  }
+
+/**
+ * @brief Maps a diagram saved by save(), read-only.
+ *
+ * @param fileName The name of the file.
+ * @param r The number of rows the diagram must have.
+ * @param c The number of columns the diagram must have.
+ * @return True if the file holds a valid diagram of that dimension, false otherwise.
+ */
+  bool LayoutZdd::open(const std::string &fileName, int r, int c) {
+    release();
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 or std::size_t(st.st_size) < sizeof(ZddHeader)) {
+      ::close(fd);
+      return false;
+    }
+    void *addr = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      return false;
+    }
+    zddMap = addr;
+    zddMapBytes = std::size_t(st.st_size);
+
+    const ZddHeader *header = static_cast<const ZddHeader*>(addr);
+    if (std::memcmp(header->magic, zdd_magic, sizeof(zdd_magic)) != 0 or header->version != zdd_version
+        or zddMapBytes != sizeof(ZddHeader) + header->nodeCount * sizeof(ZddNode)
+        or header->root >= header->nodeCount or header->rows != r or header->cols != c
+        or header->transposed != (c > r ? 1u : 0u)) {
+      release();
+      return false;
+    }
+    zddRows = short(header->rows);
+    zddCols = short(header->cols);
+    zddSize = header->nodeCount;
+    zddRoot = header->root;
+    zddTransposed = header->transposed != 0;
+    zddNodes = reinterpret_cast<const ZddNode*>(static_cast<const char*>(addr) + sizeof(ZddHeader));
+    return true;
+  }
+
+/**
+ * @brief Returns the number of valid layouts.
+ *
+ * @return The number of sets in the diagram.
+ */
+  zdd_count LayoutZdd::count() const {
+    return zddNodes ? zddNodes[zddRoot].count() : 0;
+  }
+
+/**
+ * @brief Returns the layout with number `k`, for `k` in [0, count()).
+ *
+ * @param k The number of the layout.
+ * @return The layout, with ships of each type in increasing head order.
+ */
+  PuzzleRecord LayoutZdd::unrank(zdd_count k) const {
+    std::vector<std::uint32_t> vars;
+    std::uint32_t n = zddRoot;
+    while (n > 1) {
+      const ZddNode &node = zddNodes[n];
+      zdd_count below = zddNodes[node.lo].count();
+      if (k < below) {
+        n = node.lo;
+      } else {
+        k -= below;
+        vars.push_back(node.var);
+        n = node.hi;
+      }
+    }
+    PuzzleRecord rec = recordOf(vars, zddTransposed ? zddRows : zddCols);
+    return zddTransposed ? transposed(rec) : rec;
+  }
+
+/**
+ * @brief Finds the number of a layout, the inverse of unrank().
+ *
+ * @param rec The layout.
+ * @param k Receives the number of the layout.
+ * @return True if the layout is valid (and thus has a number), false otherwise.
+ */
+  bool LayoutZdd::rank(const PuzzleRecord &layout, zdd_count &k) const {
+    PuzzleRecord rec = zddTransposed ? transposed(layout) : layout;
+    short cols = zddTransposed ? zddRows : zddCols;
+    std::vector<std::uint32_t> vars;
+    for (int t = 0; t < 4; t++) {
+      for (std::size_t i = type_first_slot[t]; i < type_first_slot[t] + std::size_t(type_max[t]); i++) {
+        int head = (rec.heads[i] >> 4) * cols + (rec.heads[i] & 0x0F);
+        bool vertical = t < 3 and ((rec.vertical >> i) & 1u);
+        vars.push_back(std::uint32_t(head * n_options + 2 * t + (vertical ? 1 : 0)));
+      }
+    }
+    std::sort(vars.begin(), vars.end());
+
+    k = 0;
+    std::size_t next = 0;
+    std::uint32_t n = zddRoot;
+    while (n > 1) {
+      const ZddNode &node = zddNodes[n];
+      if (next < vars.size() and vars[next] < node.var) {
+        return false;
+      }
+      if (next < vars.size() and vars[next] == node.var) {
+        k += zddNodes[node.lo].count();
+        n = node.hi;
+        next++;
+      } else {
+        n = node.lo;
+      }
+    }
+    return n == 1 and next == vars.size();
+  }
+
+/**
+ * @brief Draws a layout uniformly at random among all valid layouts.
+ *
+ * @param rng The random number generator.
+ * @return The layout drawn.
+ */
+  PuzzleRecord LayoutZdd::sample(std::mt19937_64 &rng) const {
+    zdd_count total = count();
+    if (total == 0) {
+      return PuzzleRecord{};
+    }
+    // Rejection keeps the draw exactly uniform.
+    zdd_count limit = ~zdd_count(0) - (~zdd_count(0) % total);
+    zdd_count x;
+    do {
+      x = (zdd_count(rng()) << 64) | rng();
+    } while (x >= limit);
+    return unrank(x % total);
+  }
+
+}
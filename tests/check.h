@@ -0,0 +1,21 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <iostream>
+
+/// Number of failed checks of the test program.
+inline int check_failures = 0;
+
+/// Reports a failed condition with its location and keeps going.
+#define CHECK(cond)                                                                  \
+  do {                                                                               \
+    if (not (cond)) {                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+      check_failures++;                                                              \
+    }                                                                                \
+  } while (0)
+
+/// Exit status of the test program.
+#define CHECK_RESULT() (check_failures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,59 @@
+#include <set>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// The randomized search returns distinct, valid puzzles and keeps to its deadline.
+void distinctWithinDeadline(unsigned short rows, unsigned short cols, unsigned short n, unsigned int ms) {
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  opt.n_puzzles = n;
+  opt.deadline_ms = ms;
+  opt.seed = 11;
+  bpg::GenerationReport report;
+  bpg::PuzzleStore store = bpg::Generator::generateAnytime(opt, report);
+  CHECK(report.found == store.size());
+  CHECK(store.size() <= n);
+  CHECK(report.deadline_hit == (store.size() < n));
+  CHECK(report.elapsed_ms < ms + 100.0);
+
+  std::set<bpg::PuzzleRecord> seen;
+  bpg::Puzzle pz(cols, rows);
+  for (const bpg::PuzzleRecord &rec : store) {
+    CHECK(seen.insert(rec.canonical()).second);
+    rec.toPuzzle(pz);
+    for (const bpg::Ship &ship : pz.puzzleShips) {
+      CHECK(ship.shipPlaced);
+    }
+  }
+}
+
+/// Without a deadline, the search still ends once a restart has covered the whole tree,
+/// which on a board without layouts happens at once.
+void endsWithoutLayouts() {
+  RunningOpt opt;
+  opt.rows = opt.cols = 7;
+  opt.n_puzzles = 10;
+  opt.seed = 11;
+  for (int r = 0; r < 6; r++) {
+    opt.forbidden[r] = 0x7F;
+  }
+  bpg::GenerationReport report;
+  CHECK(bpg::Generator::generateAnytime(opt, report).empty());
+  CHECK(not report.deadline_hit and report.restarts == 1);
+}
+
+}
+
+int main() {
+  endsWithoutLayouts();
+  distinctWithinDeadline(10, 10, 100, 5000);
+  distinctWithinDeadline(7, 7, 100, 50);
+  distinctWithinDeadline(16, 11, 40, 5000);
+  return CHECK_RESULT();
+}
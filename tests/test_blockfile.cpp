@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bpg.h"
+#include "blockfile.h"
+#include "common.h"
+#include "file.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// Whole content of a plain file.
+std::string slurp(const std::string &file) {
+  std::ifstream in(file);
+  std::stringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+/// A block file holds the text of the plain file, and each puzzle can be read on its own.
+void roundTrip(unsigned short rows, unsigned short cols, unsigned short n) {
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  opt.n_puzzles = n;
+  opt.armada_file = "test_blockfile_armada.bp";
+  opt.matrix_file = "test_blockfile_matrix.bp";
+  bpg::PuzzleStore store = bpg::Generator::generate(opt);
+  CHECK(store.size() == n);
+
+  std::remove(opt.armada_file.c_str());
+  std::remove(opt.matrix_file.c_str());
+  bpg::SaveArmada(opt, store);
+  bpg::SaveMatrix(opt, store);
+  opt.compress = true;
+  bpg::SaveArmada(opt, store);
+  bpg::SaveMatrix(opt, store);
+
+  for (const std::string &file : { opt.armada_file, opt.matrix_file }) {
+    std::string plain = slurp(file), text;
+    std::string block = bpg::BlockFileName(file);
+    CHECK(bpg::IsBlockFile(block));
+    CHECK(not bpg::IsBlockFile(file));
+    CHECK(bpg::ReadBlockFile(block, text));
+    CHECK(text == plain);
+    std::remove(file.c_str());
+    std::remove(block.c_str());
+  }
+
+  // Puzzle by puzzle, the armada file reads back as the records of the store.
+  std::string block = bpg::BlockFileName(opt.armada_file);
+  opt.compress = false;
+  bpg::SaveArmada(opt, store);
+  opt.compress = true;
+  bpg::SaveArmada(opt, store);
+  std::string whole = std::to_string(n) + '\n';
+  for (std::size_t k = 0; k < n; k++) {
+    std::string text;
+    CHECK(bpg::ReadBlockPuzzle(block, k, text));
+    whole += text;
+  }
+  std::string text;
+  CHECK(not bpg::ReadBlockPuzzle(block, n, text));
+  CHECK(whole == slurp(opt.armada_file));
+  std::remove(opt.armada_file.c_str());
+  std::remove(block.c_str());
+}
+
+/// A damaged block file is reported as such, whole or puzzle by puzzle: the header, the
+/// index, the sizes and the offsets are checked before anything is used.
+void damagedFiles() {
+  RunningOpt opt;
+  opt.rows = 8;
+  opt.cols = 8;
+  opt.n_puzzles = 100;
+  opt.armada_file = "test_blockfile_armada.bp";
+  opt.compress = true;
+  bpg::PuzzleStore store = bpg::Generator::generate(opt);
+  bpg::SaveArmada(opt, store);
+  std::string block = bpg::BlockFileName(opt.armada_file);
+  const std::string data = slurp(block);
+  std::uint64_t indexOffset;
+  std::memcpy(&indexOffset, data.data() + 32, sizeof(indexOffset));
+
+  // Position in the file and the bytes written there; no bytes cut the file at that position.
+  const std::vector<std::pair<std::size_t, std::string>> damages = {
+    { data.size() - 1, "" },                             // index cut short
+    { 24, std::string(8, '\x7f') },                      // block count
+    { 32, std::string(8, '\x7f') },                      // index offset past the end
+    { std::size_t(indexOffset), std::string(8, '\0') },   // block 0 inside the header
+    { std::size_t(indexOffset) + 8, std::string(4, '\xff') },  // compressed size past the index
+    { std::size_t(indexOffset) + 12, std::string(4, '\xff') }, // raw size no block inflates to
+    { 60, "garbage" },                                   // compressed bytes of block 0
+  };
+  for (const auto &damage : damages) {
+    std::string broken = data, text;
+    if (damage.second.empty()) {
+      broken.resize(damage.first);
+    } else {
+      broken.replace(damage.first, damage.second.size(), damage.second);
+    }
+    std::ofstream(block, std::ios::binary | std::ios::trunc) << broken;
+    CHECK(not bpg::ReadBlockFile(block, text));
+    CHECK(not bpg::ReadBlockPuzzle(block, 0, text));
+  }
+  std::remove(block.c_str());
+}
+
+}
+
+int main() {
+  damagedFiles();
+  roundTrip(10, 10, 100);
+  roundTrip(16, 9, 64);
+  roundTrip(7, 8, 1);
+  return CHECK_RESULT();
+}
@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "bpg.h"
+#include "common.h"
+#include "file.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// Writes a constraints file and reads it into opt; returns false if it was rejected.
+bool readsBack(const std::string &file, const std::string &text, RunningOpt &opt) {
+  std::ofstream(file) << text;
+  bool read = true;
+  try {
+    bpg::ReadConstraints(file, opt);
+  } catch (const std::invalid_argument &) {
+    read = false;
+  }
+  std::remove(file.c_str());
+  return read;
+}
+
+/// Every puzzle covers the ship cells and leaves the water cells empty.
+void generateWithin(const std::string &file) {
+  RunningOpt opt;
+  opt.rows = opt.cols = 10;
+  opt.n_puzzles = 50;
+  CHECK(readsBack(file, "# partial board\nship 0 2\nship 4 4\nship 9 9\nwater row 6\nwater col 0\nwater 3 3\n", opt));
+  CHECK(opt.required[0] == 1u << 2 and opt.required[4] == 1u << 4 and opt.required[9] == 1u << 9);
+  CHECK(opt.forbidden[6] == 0x3FF and opt.forbidden[3] == ((1u << 3) | 1u) and opt.forbidden[5] == 1u);
+
+  bpg::PuzzleStore store = bpg::Generator::generate(opt);
+  CHECK(store.size() == opt.n_puzzles);
+  bpg::Puzzle pz(opt.cols, opt.rows);
+  for (const bpg::PuzzleRecord &rec : store) {
+    rec.toPuzzle(pz);
+    CellMask covered{};
+    for (const bpg::Ship &ship : pz.puzzleShips) {
+      CHECK(ship.shipPlaced);
+      for (const bpg::Cell &cell : pz.getShipBody(ship)) {
+        covered[cell.row] |= std::uint16_t(1u << cell.col);
+      }
+    }
+    for (unsigned short r = 0; r < opt.rows; r++) {
+      CHECK((covered[r] & opt.required[r]) == opt.required[r]);
+      CHECK((covered[r] & opt.forbidden[r]) == 0);
+    }
+  }
+}
+
+/// Malformed lines and cells off the board are refused.
+void rejectsBadLines(const std::string &file) {
+  RunningOpt opt;
+  opt.rows = opt.cols = 10;
+  CHECK(not readsBack(file, "ship 1\n", opt));
+  CHECK(not readsBack(file, "land 1 1\n", opt));
+  CHECK(not readsBack(file, "ship 10 0\n", opt));
+  CHECK(not readsBack(file, "water col 10\n", opt));
+  CHECK(not readsBack(file, "ship 2 2\nwater row 2\n", opt));
+}
+
+/// The check only runs when some cell is required.
+void requiredFlag() {
+  bpg::Puzzle pz(10, 10);
+  CellMask cells{};
+  pz.setRequired(cells);
+  CHECK(not pz.puzzleHasRequired and pz.canCoverRequired(0));
+  cells[9] = 1u << 9;
+  pz.setRequired(cells);
+  CHECK(pz.puzzleHasRequired and pz.canCoverRequired(0));
+  pz.puzzleShips.resize(1);   // A battleship alone...
+  CHECK(pz.canCoverRequired(0));
+  cells[0] = cells[4] = 1u;   // ...cannot cover three cells that far apart.
+  pz.setRequired(cells);
+  CHECK(not pz.canCoverRequired(0));
+}
+
+}
+
+int main() {
+  requiredFlag();
+  generateWithin("test_constraints.txt");
+  rejectsBadLines("test_constraints.txt");
+  return CHECK_RESULT();
+}
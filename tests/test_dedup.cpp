@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "common.h"
+#include "dedup.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// A record drawn from a small space, so that draws repeat often.
+bpg::PuzzleRecord draw(std::mt19937_64 &rng, std::uint64_t space) {
+  std::uint64_t x = rng() % space;
+  bpg::PuzzleRecord rec;
+  for (std::size_t i = 0; i < bpg::armada_size; i++) {
+    rec.heads[i] = std::uint8_t(x >> (i * 7));
+  }
+  rec.vertical = std::uint16_t((x * 0x9E3779B97F4A7C15ull) >> 54);
+  return rec;
+}
+
+/// Under any budget, insert() answers exactly as a plain set, through spills and merges.
+void sameAsSet(std::size_t budgetBytes, std::size_t inserts, std::uint64_t space) {
+  bpg::Deduplicator dedup(budgetBytes);
+  std::set<bpg::PuzzleRecord> expected;
+  std::mt19937_64 rng(budgetBytes + inserts);
+  std::size_t wrong = 0;
+  for (std::size_t i = 0; i < inserts; i++) {
+    bpg::PuzzleRecord rec = draw(rng, space);
+    wrong += dedup.insert(rec) != expected.insert(rec).second ? 1 : 0;
+  }
+  CHECK(wrong == 0);
+  CHECK(dedup.size() == expected.size());
+  // Every record seen is still found, whether it lives in the table or in a run.
+  for (const bpg::PuzzleRecord &rec : expected) {
+    wrong += dedup.insert(rec) ? 1 : 0;
+  }
+  CHECK(wrong == 0);
+  CHECK(dedup.size() == expected.size());
+  if (budgetBytes > 0) {
+    CHECK(dedup.spills() > 8);   // More spills than runs kept, so runs were merged.
+    CHECK(dedup.runs() <= 8);
+  }
+}
+
+}
+
+int main() {
+  sameAsSet(0, 200000, 150000);
+  sameAsSet(16 * 1024, 120000, 90000);
+  sameAsSet(64 * 1024, 250000, 1000000);
+  return CHECK_RESULT();
+}
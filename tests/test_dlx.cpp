@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <initializer_list>
+#include <set>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// Body and shadow of a placement, one bit per cell in row-major order.
+struct Placement {
+  std::uint64_t body = 0, shadow = 0;
+};
+
+/// Counts layouts by depth-first search over bitboards, same-type ships in increasing placement order.
+std::size_t countAux(const std::vector<std::vector<Placement>> &placements, const bpg::Puzzle &pz,
+                     std::size_t index, std::size_t first, std::uint64_t bodies) {
+  if (index == placements.size()) {
+    return 1;
+  }
+  bool last = index + 1 == placements.size();
+  std::size_t count = 0;
+  for (std::size_t k = first; k < placements[index].size(); k++) {
+    const Placement &p = placements[index][k];
+    if (p.shadow & bodies) {
+      continue;
+    }
+    bool same = not last and pz.puzzleShips[index + 1].shipType == pz.puzzleShips[index].shipType;
+    count += countAux(placements, pz, index + 1, same ? k + 1 : 0, bodies | p.body);
+  }
+  return count;
+}
+
+/// Number of layouts of a board of at most 64 cells that leave the forbidden cells as water.
+std::size_t countLayouts(unsigned short rows, unsigned short cols, const CellMask &forbidden) {
+  bpg::Puzzle pz(cols, rows);
+  std::vector<std::vector<Placement>> placements;
+  for (bpg::Ship ship : pz.puzzleShips) {
+    placements.emplace_back();
+    bool submarine = ship.shipType == bpg::cell_t::submarine;
+    for (short r = 0; r < short(rows); r++) {
+      for (short c = 0; c < short(cols); c++) {
+        for (int v = 0; v < (submarine ? 1 : 2); v++) {
+          ship.shipHeadCell = bpg::Cell(r, c);
+          ship.shipOrientation = v ? bpg::Ship::orientation::V : bpg::Ship::orientation::H;
+          auto body = pz.getShipBody(ship);
+          if (int(body.size()) != ship.shipSize) {
+            continue;
+          }
+          Placement p;
+          for (const bpg::Cell &cell : body) {
+            p.body |= std::uint64_t(1) << (cell.row * cols + cell.col);
+            if (forbidden[cell.row] & (1u << cell.col)) {
+              p.body = 0;
+              break;
+            }
+          }
+          for (const bpg::Cell &cell : pz.getShipShadow(ship)) {
+            p.shadow |= std::uint64_t(1) << (cell.row * cols + cell.col);
+          }
+          if (p.body) {
+            placements.back().push_back(p);
+          }
+        }
+      }
+    }
+  }
+  return countAux(placements, pz, 0, 0, 0);
+}
+
+/// Mask of cells given by their row-major index.
+CellMask cellMask(unsigned short cols, std::initializer_list<int> cells) {
+  CellMask mask{};
+  for (int cell : cells) {
+    mask[cell / cols] |= std::uint16_t(1u << (cell % cols));
+  }
+  return mask;
+}
+
+/// The Dancing Links engine finds every layout, each once, as the head-cell count does.
+void sameCount(unsigned short rows, unsigned short cols, const CellMask &forbidden) {
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  opt.forbidden = forbidden;
+  opt.n_puzzles = 65535;
+  opt.engine = engine_t::dlx;
+  bpg::PuzzleStore store = bpg::Generator::generate(opt);
+  std::size_t expected = countLayouts(rows, cols, forbidden);
+  CHECK(expected > 0);
+  CHECK(store.size() == expected);
+
+  std::set<bpg::PuzzleRecord> seen;
+  bpg::Puzzle pz(cols, rows);
+  for (const bpg::PuzzleRecord &rec : store) {
+    CHECK(seen.insert(rec.canonical()).second);
+    rec.toPuzzle(pz);
+    for (const bpg::Ship &ship : pz.puzzleShips) {
+      CHECK(ship.shipPlaced);
+      for (const bpg::Cell &cell : pz.getShipBody(ship)) {
+        CHECK(not (forbidden[cell.row] & (1u << cell.col)));
+      }
+    }
+  }
+}
+
+}
+
+int main() {
+  sameCount(7, 7, cellMask(7, { 2, 21, 42, 19, 38, 15, 34 }));
+  sameCount(7, 8, cellMask(8, { 0, 9, 18, 27, 36, 45, 54, 7, 14, 21, 28, 35, 24, 52 }));
+  return CHECK_RESULT();
+}
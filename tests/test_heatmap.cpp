@@ -0,0 +1,62 @@
+#include <chrono>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "heatmap.h"
+#include "check.h"
+
+namespace {
+
+/// Few layouts left: the count is exact, and shot cells read 100% (hit) or 0% (miss).
+void exactAfterShots() {
+  bpg::HeatmapEngine engine(7, 7, 2, 9);
+  std::vector<bpg::Shot> shots = { { 1, 1, true }, { 1, 2, false }, { 2, 1, true } };
+  bpg::Heatmap map;
+  for (const bpg::Shot &shot : shots) {
+    CHECK(engine.shoot(shot));
+    map = engine.refresh(5000);
+    CHECK(map.exact and map.reliable);
+  }
+  CHECK(map.layouts == 174);
+  for (const bpg::Shot &shot : shots) {
+    double p = map.probability[shot.row * 7 + shot.col];
+    CHECK(shot.hit ? p > 0.999 : p == 0);
+  }
+  CHECK(not engine.shoot(shots[0]));
+}
+
+/// Too many layouts to count: the estimate rests on enough samples to be reported reliable.
+void sampledAfterShot() {
+  bpg::HeatmapEngine engine(16, 16, 2, 9);
+  CHECK(engine.shoot(bpg::Shot{ 3, 3, true }));
+  bpg::Heatmap map = engine.refresh(50);
+  CHECK(not map.exact);
+  CHECK(map.samples >= 100 and map.reliable);
+  CHECK(map.probability[3 * 16 + 3] > 0.999);
+}
+
+/// The budget bounds the whole refresh, counting and sampling alike; a refresh too short
+/// to get enough samples comes back on time, marked unreliable.
+void withinBudget() {
+  bpg::HeatmapEngine engine(16, 16, 2, 9);
+  CHECK(engine.shoot(bpg::Shot{ 3, 3, true }));
+  for (double budget : { 1.0, 10.0, 50.0 }) {
+    auto started = std::chrono::steady_clock::now();
+    bpg::Heatmap map = engine.refresh(budget);
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    CHECK(not map.exact);
+    CHECK(map.elapsed_ms <= elapsed and elapsed <= budget + 5);
+    CHECK(map.reliable == (map.samples >= 100));
+  }
+  CHECK(not engine.refresh(0).reliable);
+}
+
+}
+
+int main() {
+  exactAfterShots();
+  sampledAfterShot();
+  withinBudget();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,46 @@
+#include "bpg.h"
+#include "common.h"
+#include "hints.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// Each hint set fixes its solution and none of its hints can go; water hints do show up.
+void irreducible(unsigned short rows, unsigned short cols, unsigned short n, unsigned int threads) {
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  opt.n_puzzles = n;
+  bpg::PuzzleStore store = bpg::Generator::generate(opt);
+  unsigned long checks = 0;
+  std::vector<bpg::HintSet> hints = bpg::minimizeHints(store, 3, threads, checks);
+  CHECK(hints.size() == store.size());
+  CHECK(checks > 0);
+
+  std::size_t water = 0;
+  bpg::Puzzle pz(cols, rows);
+  for (std::size_t i = 0; i < store.size(); i++) {
+    store.materialize(i, pz);
+    bpg::HintSolver solver(pz);
+    for (const bpg::Hint &hint : hints[i]) {
+      solver.addHint(hint);
+      water += hint.kind == bpg::hint_t::water ? 1 : 0;
+    }
+    CHECK(solver.countSolutions(2) == 1);
+    for (const bpg::Hint &hint : hints[i]) {
+      solver.removeHint(hint);
+      CHECK(solver.countSolutions(2) == 2);
+      solver.addHint(hint);
+    }
+  }
+  CHECK(water > 0);
+}
+
+}
+
+int main() {
+  irreducible(7, 7, 30, 1);
+  irreducible(10, 10, 20, 3);
+  return CHECK_RESULT();
+}
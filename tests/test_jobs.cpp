@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "blockfile.h"
+#include "common.h"
+#include "file.h"
+#include "jobs.h"
+#include "check.h"
+
+namespace {
+
+/// Writes a manifest and reads it back; returns false if it was rejected.
+bool readsBack(const std::string &file, const std::string &text) {
+  std::ofstream(file) << text;
+  bool read = true;
+  try {
+    bpg::ReadManifest(file);
+  } catch (const std::invalid_argument &) {
+    read = false;
+  }
+  std::remove(file.c_str());
+  return read;
+}
+
+/// Two jobs may not write the same files, however the output is spelled.
+void duplicateOutputs(const std::string &file) {
+  CHECK(readsBack(file, "10 10 5 0 a\n7 7 5 0 b\n"));
+  CHECK(not readsBack(file, "10 10 5 0 a\n# comment\n7 7 5 0 a\n"));
+  CHECK(not readsBack(file, "10 10 5 0 out/a\n7 7 5 3 out/./a\n"));
+}
+
+/// Small, crowded boards are scheduled before larger, easier ones.
+void crowdedBoardsFirst() {
+  RunningOpt small, large;
+  small.rows = small.cols = 7;
+  large.rows = large.cols = 16;
+  small.n_puzzles = large.n_puzzles = 100;
+  CHECK(bpg::EstimatedCost(small) > bpg::EstimatedCost(large));
+  large.n_puzzles = 50;
+  small.cols = 8;
+  CHECK(bpg::EstimatedCost(small) > bpg::EstimatedCost(large));
+}
+
+#ifdef BPG_HAS_ZLIB
+/// Whether a file can be opened for reading.
+bool exists(const std::string &file) {
+  return std::ifstream(file).is_open();
+}
+
+/// A manifest runs end to end: every job writes its files, plain or compressed, with the puzzles asked for.
+void runManifest(const std::string &file, bool compress) {
+  std::ofstream(file) << "# dims count seed output\n8 8 20 0 test_jobs_a\n8 8 5 0 test_jobs_b\n9 7 10 3 test_jobs_c\n";
+  std::vector<bpg::Job> jobs = bpg::ReadManifest(file);
+  std::remove(file.c_str());
+  CHECK(jobs.size() == 3);
+  for (bpg::Job &job : jobs) {
+    job.opt.compress = compress;
+    // A stale file of the other kind must not survive the run.
+    std::ofstream(compress ? job.opt.armada_file : bpg::BlockFileName(job.opt.armada_file)) << "stale\n";
+  }
+  bpg::RunJobs(jobs, 2);
+
+  for (const bpg::Job &job : jobs) {
+    CHECK(job.found == job.opt.n_puzzles);
+    std::vector<std::string> written, absent;
+    for (const std::string &name : { job.opt.armada_file, job.opt.matrix_file }) {
+      written.push_back(compress ? bpg::BlockFileName(name) : name);
+      absent.push_back(compress ? name : bpg::BlockFileName(name));
+    }
+    for (const std::string &name : absent) {
+      CHECK(not exists(name));
+    }
+    CHECK(bpg::IsBlockFile(written[0]) == compress);
+    std::vector<bpg::ArmadaLayout> layouts = bpg::ReadArmada(written[0]);
+    CHECK(layouts.size() == job.opt.n_puzzles);
+    bpg::validateLayouts(layouts);
+    for (const bpg::ArmadaLayout &layout : layouts) {
+      CHECK(layout.rows == job.opt.rows and layout.cols == job.opt.cols);
+      CHECK(layout.error == bpg::layout_error::none);
+    }
+    for (const std::string &name : written) {
+      CHECK(exists(name));
+      std::remove(name.c_str());
+    }
+  }
+}
+#endif
+
+}
+
+int main() {
+  duplicateOutputs("test_jobs.txt");
+  crowdedBoardsFirst();
+#ifdef BPG_HAS_ZLIB
+  runManifest("test_jobs.txt", false);
+  runManifest("test_jobs.txt", true);
+#endif
+  return CHECK_RESULT();
+}
@@ -0,0 +1,95 @@
+#include <set>
+
+#include "bpg.h"
+#include "common.h"
+#include "mutate.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// Puzzles are valid and distinct; a run falls short only if the deadline passed, every chain
+/// stalled or no layout fits the board.
+bpg::MutationReport run(const RunningOpt &opt) {
+  bpg::MutationReport report;
+  bpg::PuzzleStore store = bpg::Generator::generateMutate(opt, report);
+  CHECK(report.found == store.size());
+  CHECK(report.found == opt.n_puzzles or report.deadline_hit or report.stalled == report.chains
+        or (report.found == 0 and report.moves == 0));
+  CHECK(report.stalled <= report.chains);
+
+  std::set<bpg::PuzzleRecord> seen;
+  bpg::Puzzle pz(opt.cols, opt.rows);
+  for (const bpg::PuzzleRecord &rec : store) {
+    CHECK(seen.insert(rec.canonical()).second);
+    rec.toPuzzle(pz);
+    for (const bpg::Ship &ship : pz.puzzleShips) {
+      CHECK(ship.shipPlaced);
+      for (const bpg::Cell &cell : pz.getShipBody(ship)) {
+        CHECK(not (opt.forbidden[cell.row] & (1u << cell.col)));
+      }
+    }
+  }
+  return report;
+}
+
+/// A seed gives the same puzzles, in the same order, whatever the threads do.
+void sameSeedSamePuzzles() {
+  RunningOpt opt;
+  opt.rows = opt.cols = 10;
+  opt.n_puzzles = 300;
+  opt.mutate_moves = 5;
+  opt.seed = 3;
+  bpg::MutationReport a, b, c;
+  bpg::PuzzleStore first = bpg::Generator::generateMutate(opt, a);
+  bpg::PuzzleStore second = bpg::Generator::generateMutate(opt, b);
+  CHECK(first.size() == opt.n_puzzles and second.size() == first.size());
+  bool same = true;
+  for (std::size_t k = 0; k < first.size() and k < second.size(); k++) {
+    same = same and first[k] == second[k];
+  }
+  CHECK(same and a.rhat == b.rhat and a.moves == b.moves);
+  opt.seed = 4;
+  bpg::PuzzleStore other = bpg::Generator::generateMutate(opt, c);
+  CHECK(not (other[0] == first[0]));
+}
+
+}
+
+int main() {
+  sameSeedSamePuzzles();
+  RunningOpt opt;
+  opt.rows = opt.cols = 10;
+  opt.n_puzzles = 200;
+  opt.mutate_moves = 20;
+  opt.seed = 7;
+  bpg::MutationReport report = run(opt);
+  CHECK(report.found == 200 and not report.deadline_hit);
+
+  // Three water rows leave few layouts: the chains stall and the shortfall is reported.
+  opt.rows = opt.cols = 7;
+  opt.forbidden[1] = opt.forbidden[3] = opt.forbidden[5] = 0x7F;
+  opt.n_puzzles = 5000;
+  opt.mutate_moves = 2;
+  report = run(opt);
+  CHECK(report.found < opt.n_puzzles and not report.deadline_hit and report.stalled == report.chains);
+
+  // Without a deadline, a board without layouts ends at once, with nothing to start from.
+  opt.forbidden = {};
+  for (int r = 0; r < 6; r++) {
+    opt.forbidden[r] = 0x7F;
+  }
+  opt.n_puzzles = 10;
+  report = run(opt);
+  CHECK(report.found == 0 and report.moves == 0 and report.elapsed_ms < 2000);
+
+  // The deadline bounds the search of the starting layouts as well as the chains.
+  opt.forbidden = {};
+  opt.rows = opt.cols = 16;
+  opt.n_puzzles = 65535;
+  opt.mutate_moves = 20;
+  opt.deadline_ms = 100;
+  report = run(opt);
+  CHECK(report.deadline_hit and report.elapsed_ms < 2000);
+  return CHECK_RESULT();
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bpg.h"
+#include "common.h"
+#include "pool.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+/// Canonical records of a store, in order.
+std::vector<bpg::PuzzleRecord> records(const bpg::PuzzleStore &store) {
+  std::vector<bpg::PuzzleRecord> out;
+  for (const bpg::PuzzleRecord &rec : store) {
+    out.push_back(rec.canonical());
+  }
+  return out;
+}
+
+/// Resuming the search batch by batch gives the puzzles of a single search, distinct and valid.
+void resumeMatchesOneShot(unsigned short rows, unsigned short cols, std::size_t n, std::size_t batch) {
+  std::vector<bpg::PuzzleRecord> expected = records(bpg::Generator::generateAfter(rows, cols, nullptr, n));
+  CHECK(expected.size() == n);
+  CHECK(std::set<bpg::PuzzleRecord>(expected.begin(), expected.end()).size() == n);
+  bpg::Puzzle pz(cols, rows);
+  for (const bpg::PuzzleRecord &rec : expected) {
+    rec.toPuzzle(pz);
+    for (const bpg::Ship &ship : pz.puzzleShips) {
+      CHECK(ship.shipPlaced);
+    }
+  }
+
+  std::vector<bpg::PuzzleRecord> resumed;
+  bpg::PuzzleRecord last;
+  while (resumed.size() < n) {
+    auto part = bpg::Generator::generateAfter(rows, cols, resumed.empty() ? nullptr : &last, batch);
+    CHECK(part.size() == batch);
+    if (part.empty()) {
+      break;
+    }
+    last = part[part.size() - 1];
+    for (const bpg::PuzzleRecord &rec : records(part)) {
+      resumed.push_back(rec);
+    }
+  }
+  resumed.resize(std::min(resumed.size(), n));
+  CHECK(resumed == expected);
+}
+
+/// Puzzles keep coming past the pool capacity, and are never handed out twice.
+void takeBeyondCapacity(const std::string &file) {
+  std::remove(file.c_str());
+  std::set<bpg::PuzzleRecord> seen;
+  {
+    bpg::PuzzlePool pool(file, 16);
+    for (int round = 0; round < 5; round++) {
+      bpg::PuzzleStore store = pool.take(10, 10, 12);
+      CHECK(store.size() == 12);
+      for (const bpg::PuzzleRecord &rec : store) {
+        CHECK(seen.insert(rec.canonical()).second);
+      }
+    }
+  }
+  // Reopened, the pool resumes where it stopped, and the refill thread tops it up.
+  bpg::PuzzlePool pool(file);
+  pool.startRefill(8);
+  bpg::PuzzleStore store = pool.take(10, 10, 12);
+  CHECK(store.size() == 12);
+  for (const bpg::PuzzleRecord &rec : store) {
+    CHECK(seen.insert(rec.canonical()).second);
+  }
+  pool.stopRefill();
+  CHECK(pool.available(10, 10) == 16);
+}
+
+/// The refill thread wakes up as soon as take() leaves a dimension low, not on its timed wait.
+void refillWakesAtOnce(const std::string &file) {
+  std::remove(file.c_str());
+  bpg::PuzzlePool pool(file, 64);
+  pool.startRefill(32);
+  for (int round = 0; round < 20; round++) {
+    CHECK(pool.take(7, 8, 40).size() == 40);
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while (pool.available(7, 8) < 64 and std::chrono::steady_clock::now() < until) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(pool.available(7, 8) == 64);
+  }
+  pool.stopRefill();
+  std::remove(file.c_str());
+}
+
+/// A truncated pool file is rejected when opened.
+void truncatedFile(const std::string &file) {
+  std::remove(file.c_str());
+  { bpg::PuzzlePool pool(file, 16); }
+  for (off_t size : { off_t(100), off_t(8192) }) {
+    CHECK(::truncate(file.c_str(), size) == 0);
+    bool rejected = false;
+    try {
+      bpg::PuzzlePool pool(file);
+    } catch (const std::runtime_error &) {
+      rejected = true;
+    }
+    CHECK(rejected);
+  }
+  std::remove(file.c_str());
+}
+
+}
+
+int main() {
+  resumeMatchesOneShot(10, 10, 100, 7);
+  resumeMatchesOneShot(7, 7, 60, 25);
+  resumeMatchesOneShot(12, 9, 300, 64);
+  takeBeyondCapacity("test_pool.bin");
+  refillWakesAtOnce("test_pool.bin");
+  truncatedFile("test_pool.bin");
+  return CHECK_RESULT();
+}
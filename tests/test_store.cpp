@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "bpg.h"
+#include "common.h"
+#include "file.h"
+#include "mutate.h"
+#include "store.h"
+#include "check.h"
+
+namespace {
+
+static_assert(sizeof(bpg::PuzzleRecord) == 12, "a record is ten head bytes and an orientation mask");
+
+/// First index of each group of same-type ships in the armada order: B | D D | C C C | S S S S.
+constexpr std::size_t groups[] = { 0, 1, 3, 6, bpg::armada_size };
+
+/// Layouts of a board spread over the whole board, drawn by Markov chains.
+bpg::PuzzleStore layouts(unsigned short rows, unsigned short cols, unsigned short n) {
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  opt.n_puzzles = n;
+  opt.seed = 11;
+  opt.mutate_moves = 20;
+  bpg::MutationReport report;
+  return bpg::Generator::generateMutate(opt, report);
+}
+
+/// Places the ships of a record on a puzzle built the way the generator builds it, ship by ship.
+void placeLive(const bpg::PuzzleRecord &rec, bpg::Puzzle &live) {
+  live = bpg::Puzzle(live.puzzleCols, live.puzzleRows);
+  for (std::size_t i = 0; i < bpg::armada_size; i++) {
+    bpg::Ship &ship = live.puzzleShips[i];
+    ship.shipHeadCell = bpg::Cell(rec.heads[i] >> 4, rec.heads[i] & 0x0F);
+    if (ship.shipType != bpg::cell_t::submarine) {
+      ship.shipOrientation = (rec.vertical & (1u << i)) ? bpg::Ship::orientation::V : bpg::Ship::orientation::H;
+    }
+    ship.shipPlaced = live.addShip(ship);
+  }
+}
+
+/// A record round-trips through a puzzle, and materialize() writes what the live puzzle wrote.
+void roundTrip(unsigned short rows, unsigned short cols) {
+  bpg::PuzzleStore store = layouts(rows, cols, 200);
+  CHECK(store.size() == 200);
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  bpg::Puzzle live(cols, rows), stored(cols, rows);
+  for (std::size_t i = 0; i < store.size(); i++) {
+    placeLive(store[i], live);
+    for (const bpg::Ship &ship : live.puzzleShips) {
+      CHECK(ship.shipPlaced);
+    }
+    CHECK(bpg::PuzzleRecord::fromPuzzle(live) == store[i]);
+
+    // Key, armada string and matrix text as the Puzzle-based writer produced them.
+    bpg::Generator::generatePuzzleKey(live);
+    bpg::Generator::generateArmada(live);
+    store.materialize(i, stored);
+    CHECK(stored.puzzleBoard == live.puzzleBoard);
+    CHECK(stored.puzzleKey == live.puzzleKey);
+    CHECK(stored.puzzleArmada == live.puzzleArmada);
+    CHECK(bpg::MatrixString(stored, opt) == bpg::MatrixString(live, opt));
+  }
+}
+
+/// Permuting ships of the same type changes the record but neither its canonical form nor the board.
+void canonicalUnderPermutations(unsigned short rows, unsigned short cols) {
+  bpg::PuzzleStore store = layouts(rows, cols, 100);
+  std::mt19937 rng(3);
+  std::set<bpg::PuzzleRecord> canonicals;
+  bpg::Puzzle pz(cols, rows), permuted(cols, rows);
+  for (const bpg::PuzzleRecord &rec : store) {
+    bpg::PuzzleRecord shuffled = rec;
+    for (std::size_t g = 0; g + 1 < std::size(groups); g++) {
+      for (std::size_t i = groups[g + 1] - 1; i > groups[g]; i--) {
+        std::size_t j = groups[g] + rng() % (i - groups[g] + 1);
+        std::swap(shuffled.heads[i], shuffled.heads[j]);
+        bool vi = shuffled.vertical & (1u << i), vj = shuffled.vertical & (1u << j);
+        shuffled.vertical &= std::uint16_t(~((1u << i) | (1u << j)));
+        shuffled.vertical |= std::uint16_t((vi ? 1u << j : 0) | (vj ? 1u << i : 0));
+      }
+    }
+    CHECK(shuffled.canonical() == rec.canonical());
+    CHECK(rec.canonical().canonical() == rec.canonical());
+    rec.toPuzzle(pz);
+    shuffled.toPuzzle(permuted);
+    bpg::Generator::generatePuzzleKey(pz);
+    bpg::Generator::generatePuzzleKey(permuted);
+    CHECK(pz.puzzleKey == permuted.puzzleKey);
+    canonicals.insert(rec.canonical());
+  }
+  // Distinct layouts keep distinct canonical forms.
+  CHECK(canonicals.size() == store.size());
+}
+
+}
+
+int main() {
+  roundTrip(7, 7);
+  roundTrip(16, 16);
+  canonicalUnderPermutations(7, 7);
+  canonicalUnderPermutations(16, 16);
+  return CHECK_RESULT();
+}
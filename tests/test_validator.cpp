@@ -0,0 +1,94 @@
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bpg.h"
+#include "common.h"
+#include "file.h"
+#include "store.h"
+#include "validator.h"
+#include "check.h"
+
+namespace {
+
+/// Valid layouts of a dimension, followed by copies with one ship moved at random.
+std::vector<bpg::ArmadaLayout> layouts(unsigned short rows, unsigned short cols) {
+  RunningOpt opt;
+  opt.rows = rows;
+  opt.cols = cols;
+  opt.n_puzzles = 50;
+  std::vector<bpg::ArmadaLayout> out;
+  for (const bpg::PuzzleRecord &rec : bpg::Generator::generate(opt)) {
+    out.push_back(bpg::ArmadaLayout{ short(rows), short(cols), rec, bpg::layout_error::none });
+  }
+  std::mt19937 rng(7);
+  std::size_t valid = out.size();
+  for (std::size_t i = 0; i < 4 * valid; i++) {
+    bpg::ArmadaLayout moved = out[i % valid];
+    std::size_t ship = rng() % bpg::armada_size;
+    moved.record.heads[ship] = std::uint8_t((rng() % rows) << 4 | (rng() % cols));
+    moved.record.vertical ^= std::uint16_t((rng() & 1) << ship);
+    out.push_back(moved);
+  }
+  return out;
+}
+
+/// Every path agrees with Puzzle::addShip, and the layouts of the generator are valid.
+void pathsAgree(unsigned short rows, unsigned short cols) {
+  std::vector<bpg::ArmadaLayout> scalar = layouts(rows, cols);
+  std::vector<bpg::ArmadaLayout> bitboard = scalar, avx2 = scalar;
+  bpg::validateLayouts(scalar, bpg::validator_path::scalar);
+  bpg::validateLayouts(bitboard, bpg::validator_path::bitboard);
+  bpg::validateLayouts(avx2, bpg::validator_path::avx2);
+  std::size_t invalid = 0;
+  for (std::size_t i = 0; i < scalar.size(); i++) {
+    CHECK(i >= 50 or scalar[i].error == bpg::layout_error::none);
+    CHECK((scalar[i].error == bpg::layout_error::none) == (bitboard[i].error == bpg::layout_error::none));
+    CHECK(bitboard[i].error == avx2[i].error);
+    invalid += scalar[i].error != bpg::layout_error::none ? 1 : 0;
+  }
+  CHECK(invalid > 0);
+}
+
+/// Error of the single puzzle of an armada text.
+bpg::layout_error parsed(const std::string &text) {
+  std::istringstream in(text);
+  std::vector<bpg::ArmadaLayout> layouts = bpg::ParseArmada(in);
+  CHECK(layouts.size() == 1);
+  bpg::validateLayouts(layouts);
+  return layouts.empty() ? bpg::layout_error::bad_armada : layouts[0].error;
+}
+
+/// Hand-edited lines with missing fields or orientations are refused, not read as zeros or H.
+void malformedLines() {
+  const std::string head = "1\n10 10\n";
+  const std::string ships = "D 2 0 H\nD 2 4 H\nC 4 0 V\nC 4 2 V\nC 4 4 V\nS 8 0\nS 8 2 H\nS 8 4 V\nS 8 6\n";
+  CHECK(parsed(head + "B 0 0 H\n" + ships) == bpg::layout_error::none);
+  CHECK(parsed(head + "B 0 0 H \n" + ships) == bpg::layout_error::none);
+  CHECK(parsed(head + "B 0 0 V\n" + ships) == bpg::layout_error::overlap);
+  CHECK(parsed(head + "B 0\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 0 x H\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 0 0\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 0 0 h\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 0 0 Horizontal\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 0 0 H H\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 1 0 H\n" + ships) == bpg::layout_error::touching);
+  CHECK(parsed(head + "X 0 0 H\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "BB 0 0 H\n" + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + ships) == bpg::layout_error::bad_armada);
+  CHECK(parsed(head + "B 0 20 H\n" + ships) == bpg::layout_error::out_of_bounds);
+  CHECK(parsed(head + "B 0 8 H\n" + ships) == bpg::layout_error::out_of_bounds);
+  CHECK(parsed(head + "B 0 0 H\n" + ships + "S 9 9\n") == bpg::layout_error::bad_armada);
+}
+
+}
+
+int main() {
+  pathsAgree(10, 10);
+  pathsAgree(7, 9);
+  pathsAgree(16, 16);
+  malformedLines();
+  return CHECK_RESULT();
+}
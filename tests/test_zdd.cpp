@@ -0,0 +1,76 @@
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+
+#include "bpg.h"
+#include "common.h"
+#include "store.h"
+#include "zdd.h"
+#include "check.h"
+
+namespace {
+
+/// Layouts fetched by number are valid, distinct, and get their number back from rank().
+void roundTrip(const bpg::LayoutZdd &zdd) {
+  bpg::zdd_count total = zdd.count();
+  CHECK(total > 0);
+  std::set<bpg::PuzzleRecord> seen;
+  bpg::Puzzle pz(zdd.zddCols, zdd.zddRows);
+  std::mt19937_64 rng(5);
+  for (int i = 0; i < 300; i++) {
+    bpg::zdd_count k = i < 100 ? bpg::zdd_count(i) : (i < 200 ? total - 1 - bpg::zdd_count(i - 100) : rng() % total);
+    bpg::PuzzleRecord rec = zdd.unrank(k);
+    bpg::zdd_count back = 0;
+    CHECK(zdd.rank(rec, back));
+    CHECK(back == k);
+    CHECK(i >= 200 or seen.insert(rec.canonical()).second);
+    rec.toPuzzle(pz);
+    for (const bpg::Ship &ship : pz.puzzleShips) {
+      CHECK(ship.shipPlaced);
+    }
+  }
+}
+
+/// A saved diagram opens only as the dimension it was built for, and counts the same.
+void saveAndOpen(const bpg::LayoutZdd &zdd, const std::string &file) {
+  CHECK(zdd.save(file));
+  bpg::LayoutZdd mapped;
+  CHECK(zdd.zddRows == zdd.zddCols or not mapped.open(file, zdd.zddCols, zdd.zddRows));
+  CHECK(not mapped.open(file, zdd.zddRows + 1, zdd.zddCols));
+  CHECK(mapped.open(file, zdd.zddRows, zdd.zddCols));
+  CHECK(mapped.count() == zdd.count());
+  CHECK(mapped.nodeCount() == zdd.nodeCount());
+  roundTrip(mapped);
+  std::remove(file.c_str());
+}
+
+}
+
+int main() {
+  bpg::LayoutZdd square;
+  CHECK(square.build(7, 7));
+  CHECK(square.count() == 406664);   // Same as the Dancing Links engine and the resumable search.
+  roundTrip(square);
+  saveAndOpen(square, "test_zdd.zdd");
+
+  // A wide board is built as its transpose, with as many layouts as the tall one.
+  bpg::LayoutZdd tall, wide;
+  CHECK(tall.build(8, 7));
+  CHECK(wide.build(7, 8));
+  CHECK(tall.count() == wide.count());
+  roundTrip(wide);
+  saveAndOpen(wide, "test_zdd.zdd");
+
+  // The default 10x10 board fits the budget; past it, boards are refused at once and a
+  // build over its budget gives up instead of growing.
+  bpg::LayoutZdd ten;
+  CHECK(bpg::LayoutZdd::supported(10, 10) and bpg::LayoutZdd::supported(16, 10));
+  CHECK(bpg::LayoutZdd::supported(11, 11) and not bpg::LayoutZdd::supported(12, 11));
+  CHECK(ten.build(10, 10));
+  CHECK(bpg::countToString(ten.count()) == "1855545978831780");
+  roundTrip(ten);
+  CHECK(not ten.build(10, 10, 1000000));
+  CHECK(not ten.build(13, 13, std::size_t(-1)));
+  return CHECK_RESULT();
+}